@@ -1,10 +1,22 @@
 #include "apriori.hpp"
 #include "hash_tree.hpp"
+#include "stats.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_set>
+
+using std::chrono::duration;
+using std::chrono::high_resolution_clock;
 
 #ifdef _DEBUG
 #define	DPRINT(fmt, ...) fprintf(stderr, fmt, ##__VA_ARGS__)
@@ -12,41 +24,344 @@
 #define DPRINT(fmt, ...) 
 #endif
 
-#ifdef _DEBUG
-	int delete_counter=0; // used to count how many candidates were deleted
-#endif
+/* number of transactions a worker claims at a time when counting support */
+#define COUNT_BLOCK 256
+
+/* the number of most frequent items the seeds of apriori_top are grown from, and how many times more seeds than
+ * itemsets wanted are grown, and pairs tried per seed, since many seeds turn out rare or repeated */
+#define SEED_POOL 64
+#define SEED_TRIES 4
+
+/**
+ * Counts the support of the candidates in hash_tree over all transactions.
+ * The transactions are split into blocks which are claimed by the worker threads.
+ * Every worker has its own traversal state and count buffer which are merged once all workers finish,
+ * so the resulting counts are identical to those of a single threaded run.
+ * @param counts    [out_param] counts[id] is the support count of the candidate with the given id in hash_tree
+ * @param T         the transactions. Transactions which do not contain any candidate are compacted away if erase is set.
+ * @param hash_tree the hash tree of the candidates
+ * @param threads   the number of worker threads
+ * @param erase     whether to compact away the transactions which do not contain any candidate
+ * @return          the number of transactions erased
+ */
+int count_support(std::vector<int> &counts, DB &T, const HashTree &hash_tree, int threads, const bool erase) {
+	int n = (int) T.size();
+	if (threads > (n+COUNT_BLOCK-1)/COUNT_BLOCK)
+		threads = std::max(1, (n+COUNT_BLOCK-1)/COUNT_BLOCK);
+
+	std::vector<HashTreeCounter> counters(threads);
+	for (HashTreeCounter &counter : counters)
+		counter.counts.assign(hash_tree.size(), 0);
+	std::vector<char> touched(n, 0);
+	std::atomic<int> next(0);
+	auto work = [&](int w) {
+		HashTreeCounter &counter = counters[w];
+		for (int lo; (lo = next.fetch_add(COUNT_BLOCK)) < n; ) {
+			int hi = std::min(n, lo+COUNT_BLOCK);
+			for (int i=lo; i<hi; i++)
+				touched[i] = hash_tree(T[i], counter);
+		}
+	};
+
+	if (threads == 1)
+		work(0);
+	else {
+		std::vector<std::thread> workers;
+		for (int w=0; w<threads; w++)
+			workers.push_back( std::thread(work, w) );
+		for (std::thread &worker : workers)
+			worker.join();
+	}
+
+	/* merge the per-worker counts */
+	counts.swap(counters[0].counts);
+	for (int w=1; w<threads; w++)
+		for (int id=0, c_sz=(int) counts.size(); id<c_sz; id++)
+			counts[id] += counters[w].counts[id];
 
+	/* erase the transactions the hash tree didn't touch */
+	return erase? (int) T.compact(touched): 0;
+}
+
+/**
+ * Counts the candidates of every level, and every item if item_counts is given. The items and the larger candidates,
+ * with a hash tree per level, are counted in one pass whose transactions are split into blocks claimed by the worker
+ * threads, as in count_support. The pairs, usually most of the candidates, are counted in a second pass into a single
+ * PairCounts over the items of C[1], as in count_pairs, whose workers each own a share of its rows, so that the
+ * memory stays at one triangle however many threads there are.
+ * @param item_counts [out_param] if not empty, item_counts[i] is the support count of item i
+ * @param counts      [out_param] counts[k][id] is the support count of C[k][id]
+ * @param T           the transactions
+ * @param C           C[k] are the candidate (k+1)-itemsets in lexicographical order, C[0] is ignored
+ * @param params      the parameters used, i.e., hfrange, maxleafsize and threads
+ */
+void count_levels(std::vector<int> &item_counts, std::vector< std::vector<int> > &counts, const DB &T,
+	const std::vector<Itemsets> &C, const Params &params) {
+	size_t levels = C.size();
+	std::vector<HashTree> trees(levels);
+	for (size_t k=2; k<levels; k++)
+		if (!C[k].empty())
+			trees[k] = HashTree(C[k], params.hfrange, params.maxleafsize);
+
+	/* the items of the pairs get the dense codes [0, m) */
+	std::vector<int> code;
+	int m = 0;
+	if (levels > 1 && !C[1].empty()) {
+		Item top = 0;
+		for (const Itemset &c : C[1])
+			top = std::max(top, c[1]);
+		code.assign(top+1, -1);
+		for (const Itemset &c : C[1])
+			code[ c[0] ] = code[ c[1] ] = 0;
+		for (int &id : code)
+			if (id == 0)
+				id = m++;
+	}
+
+	int n = (int) T.size(), threads = std::max(1, std::min(params.threads, (n+COUNT_BLOCK-1)/COUNT_BLOCK));
+	std::vector< std::vector<HashTreeCounter> > counters(threads, std::vector<HashTreeCounter>(levels));
+	std::vector< std::vector<int> > items(threads);
+	for (int w=0; w<threads; w++) {
+		items[w].assign(item_counts.size(), 0);
+		for (size_t k=2; k<levels; k++)
+			counters[w][k].counts.assign(C[k].size(), 0);
+	}
+	std::atomic<int> next(0);
+	auto work = [&](int w) {
+		std::vector<int> &item = items[w];
+		for (int lo; (lo = next.fetch_add(COUNT_BLOCK)) < n; )
+			for (int x=lo, hi=std::min(n, lo+COUNT_BLOCK); x<hi; x++) {
+				Transaction t = T[x];
+				if (!item.empty())
+					for (Item i : t)
+						item[i]++;
+				for (size_t k=2; k<levels; k++)
+					if (!C[k].empty())
+						trees[k](t, counters[w][k]);
+			}
+	};
+	if (threads == 1)
+		work(0);
+	else {
+		std::vector<std::thread> workers;
+		for (int w=0; w<threads; w++)
+			workers.push_back( std::thread(work, w) );
+		for (std::thread &worker : workers)
+			worker.join();
+	}
+
+	/* merge the per-worker counts */
+	item_counts.swap(items[0]);
+	counts.assign(levels, std::vector<int>());
+	if (m) {
+		PairCounts pairs(m);
+		pairs.count(T, code, params.threads);
+		for (const Itemset &c : C[1])
+			counts[1].push_back( pairs(code[c[0]], code[c[1]]) );
+	}
+	for (size_t k=2; k<levels; k++)
+		counts[k].swap(counters[0][k].counts);
+	for (int w=1; w<threads; w++) {
+		for (size_t i=0; i<item_counts.size(); i++)
+			item_counts[i] += items[w][i];
+		for (size_t k=2; k<levels; k++)
+			for (size_t id=0; id<counts[k].size(); id++)
+				counts[k][id] += counters[w][k].counts[id];
+	}
+}
+
+/**
+ * Counts every pair of coded items in the transactions, adding to the counts. The items without a code are skipped.
+ * The workers split the rows of the array between them, so no counts are shared or merged.
+ * @param T       the transactions
+ * @param code    the code in [0, size()) of every item, or -1, increasing with the item.
+ *                If empty, the transactions are recoded already and every item is its own code.
+ * @param threads the number of worker threads
+ */
+void PairCounts::count(const DB &T, const std::vector<int> &code, int threads) {
+	int m = size(), code_sz = (int) code.size();
+	if (m < 2)
+		return;
+
+	/* split the rows between the workers so that each gets about the same number of cells */
+	threads = std::max(1, std::min(threads, m-1));
+	std::vector<int> bound(threads+1, m-1);
+	bound[0] = 0;
+	for (int a=0, w=1; a<m-1 && w<threads; a++)
+		if (row[a+1] >= tri.size()*w/threads)
+			bound[w++] = a+1;
+
+	size_t n = T.size();
+	auto work = [&](int w) {
+		int lo = bound[w], hi = bound[w+1];
+		std::vector<int> ids;
+		for (size_t x=0; x<n; x++) {
+			Transaction t = T[x];
+			const int *a = t.begin(), *end = t.end();
+			if (code_sz) {
+				ids.clear();
+				for (Item i : t)
+					if (i < code_sz && code[i] >= 0)
+						ids.push_back(code[i]);
+				a = ids.data();
+				end = a+ids.size();
+			}
+			for (; a+1<end && *a<hi; a++)
+				if (*a >= lo) {
+					int *cell = tri.data()+row[*a]-*a-1;
+					for (const int *b=a+1; b!=end; b++)
+						cell[*b]++;
+				}
+		}
+	};
+
+	if (threads == 1)
+		work(0);
+	else {
+		std::vector<std::thread> workers;
+		for (int w=0; w<threads; w++)
+			workers.push_back( std::thread(work, w) );
+		for (std::thread &worker : workers)
+			worker.join();
+	}
+}
+
+/**
+ * Finds the frequent 2-itemsets by counting every pair of frequent items directly.
+ * The items are the dense ids [0, m) of the frequent items and the pairs are counted in a PairCounts,
+ * so no candidates or hash tree are needed.
+ * Only the pairs which reach minsup are turned into itemsets, in the same order apriori_gen generates them.
+ * @param F2      [out_param] the frequent 2-itemsets
+ * @param S2      [out_param] the support count of every frequent 2-itemset
+ * @param T       the recoded transactions, each with at least two items
+ * @param m       the number of frequent items. Assumes at least two.
+ * @param minsup  the minimum support count
+ * @param threads the number of worker threads
+ */
+static void count_pairs(Itemsets &F2, std::vector<int> &S2, const DB &T, const int m, const int minsup, int threads) {
+	PairCounts pairs(m);
+	pairs.count(T, std::vector<int>(), threads);
+
+	/* extract the frequent 2-itemsets */
+	for (int a=0; a<m-1; a++)
+		for (int b=a+1; b<m; b++) {
+			int sup = pairs(a, b);
+			if (sup >= minsup) {
+				F2.push_back( Itemset({a, b}) );
+				S2.push_back(sup);
+			}
+		}
+}
+
+/**
+ * Strips the items which can't be part of a frequent (k+1)-itemset from the transactions.
+ * Such an item is in less than k of the frequent k-itemsets, since all k of its k-subsets containing it must be frequent.
+ * Transactions left with less than k+1 items are removed.
+ * @param T  the recoded transactions
+ * @param Fk all frequent k-itemsets
+ * @param m  the number of frequent items
+ * @return   the number of removed transactions
+ */
+static int trim_items(DB &T, const Itemsets &Fk, const int m) {
+	int k = (int) Fk.back().size();
+	std::vector<int> occurrences(m, 0), code(m, -1);
+	for (const Itemset &s : Fk)
+		for (Item i : s)
+			occurrences[i]++;
+	for (Item i=0; i<m; i++)
+		if (occurrences[i] >= k)
+			code[i] = i;
+	return (int) T.recode(code, k+1, false);
+}
+
+
+/**
+ * Maps the recoded itemsets back to the original items, ordering them lexicographically again
+ * @param sigma [out_param] the support counts of the itemsets
+ * @param F     the recoded itemsets, decoded in place
+ * @param S     S[k][x] is the support count of F[k][x]
+ * @param items the original item of every id
+ */
+static void decode(SupportCountTable &sigma, std::vector<Itemsets> &F, const std::vector< std::vector<int> > &S, const std::vector<Item> &items) {
+	for (size_t k=0; k<F.size(); k++) {
+		std::vector< std::pair<Itemset, int> > decoded;
+		decoded.reserve(F[k].size());
+		for (size_t x=0; x<F[k].size(); x++) {
+			Itemset s;
+			for (Item id : F[k][x])
+				s.push_back(items[id]);
+			std::sort(s.begin(), s.end());
+			decoded.push_back( std::make_pair(std::move(s), S[k][x]) );
+		}
+		std::sort(decoded.begin(), decoded.end());
+
+		F[k].clear();
+		for (auto &entry : decoded) {
+			sigma[entry.first] = entry.second;
+			F[k].push_back( std::move(entry.first) );
+		}
+	}
+}
 
 /**
  * Performs the apriori algorithm for finding frequent itemsets.
+ * The frequent items are recoded to dense ids ordered by increasing support and the infrequent items are dropped
+ * from the transactions. Each later level strips the items which can no longer be part of a frequent itemset.
+ * The itemsets are mapped back to the original items once all levels are found.
  * @param sigma  	[out_parameter] the support counts for all itemsets
  * @param F      	[out_parameter] a vector of frequent itemsets where F[k] is the vector of all frequent k-itemsets
- * @param T      	all transactions
- * @param params 	the parameters used, i.e., minsup, hfrange, maxleafsize 
+ * @param T      	all transactions. Recoded and pruned in place.
+ * @param params 	the parameters used, i.e., minsup, hfrange, maxleafsize, threads
  * @param maxitem the largest item found in all transactions
+ * @param stats   [out_parameter] if given, receives what happened at every level
  */
-void apriori(SupportCountTable &sigma, std::vector<Itemsets> &F, DB &T, const Params &params, const Item maxitem) {
+void apriori(SupportCountTable &sigma, std::vector<Itemsets> &F, DB &T, const Params &params, const Item maxitem, MiningStats *stats) {
 	/* extract relevant parameters */
 	int minsup = params.minsup, hfrange = params.hfrange, maxleafsize = params.maxleafsize;
 
+	/* the level statistics are always recorded, they are cheap compared to a level */
+	MiningStats local_stats;
+	MiningStats &st = stats? *stats: local_stats;
+	st.levels.clear();
+	high_resolution_clock::time_point t0 = high_resolution_clock::now(), t1;
+
 	/* clean slate */
 	F.clear();
 
-	/* find all 1-frequent itemsets */
-	F.push_back(Itemsets()); // initially empty 1-frequent itemsets
-	for (Transaction t : T) // get the suport count for all 1-itemsets
+	/* get the suport count for all 1-itemsets */
+	std::vector<int> counts(maxitem+1, 0);
+	for (const Transaction &t : T)
 		for (Item i : t)
-			sigma[ Itemset({i}) ] += 1;
-	for (Item item=0; item<=maxitem; item++) {// extract the frequent 1-itemsets
-		Itemset s({item}); 
-		if (sigma[s] >= minsup)
-			F.back().push_back(s);
-		else
-			sigma.erase(s);
-	}
+			counts[i]++;
+	LevelStats &l1 = st.level(1);
+	t1 = high_resolution_clock::now();
+	l1.count_time = duration<double>(t1-t0).count();
+
+	/* recode the frequent items by increasing support, dropping the infrequent items and transactions with less than two */
+	std::vector<Item> items; // the original item of every id
+	for (Item item=0; item<=maxitem; item++)
+		if (counts[item] >= minsup)
+			items.push_back(item);
+	std::stable_sort(items.begin(), items.end(), [&](Item a, Item b) { return counts[a] < counts[b]; });
+	int m = (int) items.size();
+	std::vector<int> code(maxitem+1, -1);
+	for (int id=0; id<m; id++)
+		code[ items[id] ] = id;
+	l1.candidates = maxitem+1;
+	l1.transactions = T.size();
+	l1.trimmed = T.recode(code, 2, true);
 
-	/* reserve sigma for support counting */
-	sigma.reserve(F.back().size()*1000);
+	/* the frequent 1-itemsets and the support counts S[k] of the frequent itemsets in F[k] */
+	std::vector< std::vector<int> > S(1);
+	F.push_back(Itemsets()); 
+	for (int id=0; id<m; id++) {
+		F.back().push_back( Itemset({id}) );
+		S.back().push_back( counts[ items[id] ] );
+	}
+	t0 = high_resolution_clock::now();
+	l1.frequent = m;
+	l1.prune_time = duration<double>(t0-t1).count();
+	l1.peak_rss_kb = peak_rss_kb();
 
 	DPRINT("total number of 1-itemsets: %i\n", maxitem);
 	DPRINT("# of frequent 1-itemsets: %zu\n", F.back().size());
@@ -55,184 +370,640 @@ void apriori(SupportCountTable &sigma, std::vector<Itemsets> &F, DB &T, const Pa
 	/* Generate all frequent itemsets */
 	for (int k=1; F.back().size()>1; k++) {
 		DPRINT("\n>>> k : %i\n", k);
+		F.push_back(Itemsets());
+		S.push_back(std::vector<int>());
+		LevelStats &level = st.level(k+1);
 
-		/* Prune the database */
-		prune_db(T, F.back());
+		/* Count the 2-itemsets directly instead of generating candidates */
+		if (k == 1) {
+			t0 = high_resolution_clock::now();
+			count_pairs(F.back(), S.back(), T, m, minsup, params.threads);
+			t1 = high_resolution_clock::now();
+			level.candidates = (uint64_t) m*(m-1)/2;
+			level.transactions = T.size();
+			level.frequent = F.back().size();
+			level.count_time = duration<double>(t1-t0).count();
+			level.peak_rss_kb = peak_rss_kb();
+			DPRINT("# of frequent %i-itemsets: %zu\n", k+1, F.back().size());
+			continue;
+		}
+		const Itemsets &Fk = F[k-1];
+
+		/* Trim and prune the database */
+		t0 = high_resolution_clock::now();
+		level.trimmed = trim_items(T, Fk, m);
+		DPRINT("# of transactions left too short by trimming: %llu\n", (unsigned long long) level.trimmed);
+		level.pruned_db = prune_db(T, Fk);
 		DPRINT("# of transactions: %zu\n", T.size());
+		t1 = high_resolution_clock::now();
+		level.prune_time = duration<double>(t1-t0).count();
 
 		/* Generate the candidate itemset for this level */
 		Itemsets C;
-		apriori_gen(C, F.back());
-		if (C.size() == 0)
+		level.subset_pruned = apriori_gen(C, Fk, params.threads);
+		level.candidates = C.size();
+		level.transactions = T.size();
+		t0 = high_resolution_clock::now();
+		level.gen_time = duration<double>(t0-t1).count();
+		if (C.size() == 0) {
+			level.peak_rss_kb = peak_rss_kb();
+			F.pop_back();
+			S.pop_back();
 			break;
+		}
 
-		DPRINT("# of generated candidates pruned: %i\n", delete_counter);
+		DPRINT("# of generated candidates pruned: %llu\n", (unsigned long long) level.subset_pruned);
 		DPRINT("# of remaining candidates: %zu\n", C.size());
 
 		/* Generate the hash tree for the candidate itemsets and perform support counting */
-#ifdef _DEBUG
-		int counter;
-#endif
-		HashTree hash_tree(C, &sigma, hfrange, maxleafsize);
-		for (auto it=T.begin(); it!=T.end(); )
-			if ( !hash_tree(*it) ) {
-				it = T.erase(it);
-#ifdef _DEBUG
-				counter++;
-#endif				
-			}
-			else
-				it++;
-		DPRINT("# of transactions pruned by ht: %i\n", counter);
+		HashTree hash_tree(C, hfrange, maxleafsize);
+		t1 = high_resolution_clock::now();
+		level.build_time = duration<double>(t1-t0).count();
+		level.tree_nodes = hash_tree.num_nodes();
+		level.tree_leaves = hash_tree.num_leaves();
+		level.tree_depth = hash_tree.depth();
+		level.tree_branching = hash_tree.branching();
+		level.tree_leaf_size = hash_tree.leaf_size();
+		level.pruned_tree = count_support(counts, T, hash_tree, params.threads);
+		DPRINT("# of transactions pruned by ht: %llu\n", (unsigned long long) level.pruned_tree);
 
 		/* Get the frequent itemsets */		
-		F.push_back(Itemsets());
-		for (const Itemset &s : C)
-			if (sigma[s] >= minsup)
-				F.back().push_back(s);
-			else
-				sigma.erase(s);
+		for (int id=0, c_sz=(int) C.size(); id<c_sz; id++)
+			if (counts[id] >= minsup) {
+				F.back().push_back( std::move(C[id]) );
+				S.back().push_back(counts[id]);
+			}
+		t0 = high_resolution_clock::now();
+		level.frequent = F.back().size();
+		level.count_time = duration<double>(t0-t1).count();
+		level.peak_rss_kb = peak_rss_kb();
 		DPRINT("# of frequent %i-itemsets: %zu\n", k+1, F.back().size());
 	}
 
+	decode(sigma, F, S, items);
 }
 
 
+/**
+ * Grows itemsets of the given length from the most frequent pairs, so their support can be counted exactly
+ * before the levels in between are generated. Every seed starts from a pair and repeatedly adds the item of the
+ * SEED_POOL most frequent ones whose lowest pair support with the seed's items is the highest.
+ * @param seeds  [out_param] up to max_seeds distinct itemsets of length items in lexicographical order, as the hash tree needs
+ * @param F2     the frequent pairs in lexicographical order, over the ids of items ordered by increasing support
+ * @param S2     the support count of every pair
+ * @param m      the number of frequent items
+ * @param length the length of the seeds, at least 3
+ * @param max_seeds the number of seeds wanted
+ */
+static void grow_seeds(Itemsets &seeds, const Itemsets &F2, const std::vector<int> &S2, const int m, const size_t length, const size_t max_seeds) {
+	auto pair_sup = [&](Item a, Item b) {
+		Itemset pair({std::min(a, b), std::max(a, b)});
+		auto it = std::lower_bound(F2.begin(), F2.end(), pair);
+		return it != F2.end() && *it == pair? S2[it-F2.begin()]: 0;
+	};
+	std::vector<int> order(F2.size());
+	for (size_t x=0; x<order.size(); x++)
+		order[x] = (int) x;
+	std::stable_sort(order.begin(), order.end(), [&S2](int a, int b) { return S2[a] > S2[b]; });
+
+	std::unordered_set<Itemset, ItemsetHash> seen;
+	for (size_t x=0; x<order.size() && x<SEED_TRIES*max_seeds && seeds.size()<max_seeds; x++) {
+		Itemset seed(F2[ order[x] ]);
+		while (seed.size() < length) {
+			Item best = -1;
+			int best_sup = 0;
+			for (Item c=std::max(0, m-SEED_POOL); c<m; c++) {
+				if (std::find(seed.begin(), seed.end(), c) != seed.end())
+					continue;
+				int sup = INT32_MAX;
+				for (Item i : seed)
+					sup = std::min(sup, pair_sup(i, c));
+				if (sup > best_sup) {
+					best = c;
+					best_sup = sup;
+				}
+			}
+			if (best < 0)
+				break;
+			seed.push_back(best);
+		}
+		std::sort(seed.begin(), seed.end());
+		if (seed.size() == length && seen.insert(seed).second)
+			seeds.push_back(std::move(seed));
+	}
+	std::sort(seeds.begin(), seeds.end());
+}
+
+/**
+ * Finds the top_k most frequent itemsets of at least min_length items without knowing their minsup, level by level
+ * as apriori does. The supports of the best top_k itemsets found so far are kept in a heap and minsup is raised to
+ * the lowest of them as soon as there are top_k, so every level only counts candidates which can still make it.
+ * Itemsets of fewer than min_length items don't count towards top_k but are kept while frequent, since the
+ * longer itemsets are generated from them. So that minsup rises before those levels, top_k seeds of min_length items
+ * are grown from the pairs and counted exactly once the pairs are known. The itemsets tied with the last one are
+ * returned as well.
+ * @param sigma  	[out_parameter] the support counts of the found itemsets
+ * @param F      	[out_parameter] the found itemsets where F[k] holds those of k+1 items, empty below min_length
+ * @param T      	all transactions. Recoded and pruned in place.
+ * @param params 	the parameters used, i.e., top_k, min_length, minsup as the lowest support to consider, hfrange,
+ *                maxleafsize and threads
+ * @param maxitem the largest item found in all transactions
+ * @return        the support of the last of the top_k itemsets, or minsup if there are less
+ */
+int apriori_top(SupportCountTable &sigma, std::vector<Itemsets> &F, DB &T, const Params &params, const Item maxitem) {
+	size_t top_k = (size_t) params.top_k, min_length = (size_t) std::max(1, params.min_length);
+	int minsup = std::max(1, params.minsup);
+	std::priority_queue< int, std::vector<int>, std::greater<int> > best;
+	auto offer = [&](const int sup, const size_t length) {
+		if (length < min_length || sup < minsup)
+			return;
+		best.push(sup);
+		if (best.size() > top_k)
+			best.pop();
+		if (best.size() == top_k)
+			minsup = std::max(minsup, best.top());
+	};
+
+	/* keeps the itemsets of a level which still reach minsup */
+	auto keep_frequent = [&minsup](Itemsets &Fk, std::vector<int> &Sk) {
+		size_t w = 0;
+		for (size_t x=0; x<Fk.size(); x++)
+			if (Sk[x] >= minsup) {
+				if (w != x)
+					Fk[w] = std::move(Fk[x]);
+				Sk[w++] = Sk[x];
+			}
+		Fk.resize(w);
+		Sk.resize(w);
+	};
+
+	/* clean slate */
+	F.clear();
+
+	/* the 1-itemsets, recoding the frequent items by increasing support as apriori does */
+	std::vector<int> counts(maxitem+1, 0);
+	for (const Transaction &t : T)
+		for (Item i : t)
+			counts[i]++;
+	for (Item item=0; item<=maxitem; item++)
+		offer(counts[item], 1);
+	std::vector<Item> items; // the original item of every id
+	for (Item item=0; item<=maxitem; item++)
+		if (counts[item] >= minsup)
+			items.push_back(item);
+	std::stable_sort(items.begin(), items.end(), [&](Item a, Item b) { return counts[a] < counts[b]; });
+	int m = (int) items.size();
+	std::vector<int> code(maxitem+1, -1);
+	for (int id=0; id<m; id++)
+		code[ items[id] ] = id;
+	T.recode(code, 2, true);
+
+	std::vector< std::vector<int> > S(1);
+	F.push_back(Itemsets());
+	for (int id=0; id<m; id++) {
+		F.back().push_back( Itemset({id}) );
+		S.back().push_back( counts[ items[id] ] );
+	}
+
+	/* the larger itemsets, raising minsup with every itemset found */
+	std::unordered_set<Itemset, ItemsetHash> seeded;
+	for (int k=1; F.back().size()>1; k++) {
+		F.push_back(Itemsets());
+		S.push_back(std::vector<int>());
+		if (k == 1)
+			count_pairs(F.back(), S.back(), T, m, minsup, params.threads);
+		else {
+			const Itemsets &Fk = F[k-1];
+			trim_items(T, Fk, m);
+			prune_db(T, Fk);
+			Itemsets C;
+			apriori_gen(C, Fk, params.threads);
+			if (C.empty()) {
+				F.pop_back();
+				S.pop_back();
+				break;
+			}
+			HashTree hash_tree(C, params.hfrange, params.maxleafsize);
+			count_support(counts, T, hash_tree, params.threads);
+			for (int id=0, c_sz=(int) C.size(); id<c_sz; id++)
+				if (counts[id] >= minsup) {
+					F.back().push_back( std::move(C[id]) );
+					S.back().push_back(counts[id]);
+				}
+		}
+		for (size_t x=0; x<F.back().size(); x++)
+			if (!seeded.count(F.back()[x])) // the seeds were offered already
+				offer(S.back()[x], k+1);
+
+		/* count the seeds once the pairs are known, if the levels up to min_length can't fill the heap */
+		if (k == 1 && min_length > 2 && best.size() < top_k) {
+			Itemsets seeds;
+			grow_seeds(seeds, F[1], S[1], m, min_length, SEED_TRIES*top_k);
+			if (!seeds.empty()) {
+				HashTree hash_tree(seeds, params.hfrange, params.maxleafsize);
+				count_support(counts, T, hash_tree, params.threads, false);
+				for (size_t x=0; x<seeds.size(); x++) {
+					offer(counts[x], min_length);
+					seeded.insert( std::move(seeds[x]) );
+				}
+			}
+		}
+		keep_frequent(F.back(), S.back());
+	}
+
+	/* only the itemsets of at least min_length items reaching the final minsup are returned */
+	for (size_t k=0; k<F.size(); k++) {
+		if (k+1 < min_length) {
+			F[k].clear();
+			S[k].clear();
+		}
+		else
+			keep_frequent(F[k], S[k]);
+	}
+	decode(sigma, F, S, items);
+	return minsup;
+}
+
+/* hashing and comparing itemsets through pointers, so that f_set can be indexed without copying it */
+struct ItemsetPtrHash {
+	size_t operator()(const Itemset *s) const { return ItemsetHash()(*s); }
+};
+struct ItemsetPtrEqual {
+	bool operator()(const Itemset *a, const Itemset *b) const { return *a == *b; }
+};
+typedef std::unordered_set<const Itemset*, ItemsetPtrHash, ItemsetPtrEqual> ItemsetIndex;
+
+/**
+ * Merges the frequent k-itemsets f_set[lo, hi), which are whole prefix equivalence classes, into candidates.
+ * @param out_C [out_param] the candidates, appended in lexicographical order
+ * @param f_set the frequent k-itemsets, k>1
+ * @param index the index of f_set used to check that every k-subset of a candidate is frequent
+ * @param lo    the first itemset of the classes
+ * @param hi    one past the last itemset of the classes
+ * @return      the number of merged candidates which had an infrequent k-subset
+ */
+static int merge_classes(Itemsets &out_C, const Itemsets &f_set, const ItemsetIndex &index, const int lo, const int hi) {
+	int k = (int) f_set.back().size(), pruned = 0;
+	Itemset s(k+1), sub(k);
+	for (int i=lo; i<hi; i++) {
+		const Itemset& s1=f_set[i];
+		std::copy(s1.begin(), s1.end(), s.begin());
+		for (int j=i+1; j<hi && std::equal(s1.begin(), s1.end()-1, f_set[j].begin()); j++) {
+			/* create the candidate */
+			s[k] = f_set[j].back();
+
+			/* level-wise pruning trick: check if all k-itemset subsets of s are contained in f_set.
+			 * Removing s[k] or s[k-1] gives s1 or f_set[j], so only the other subsets are looked up. */
+			bool to_add = true;
+			for (int ii=k-2; ii>=0 && to_add; ii--) { // ii corresponds to the index of the removed element in s to create k-itemset
+				std::copy(s.begin(), s.begin()+ii, sub.begin());
+				std::copy(s.begin()+ii+1, s.end(), sub.begin()+ii);
+				to_add = index.count(&sub) > 0;
+			}
+
+			/* add candidate to the set of all candidates */
+			if (to_add)
+				out_C.push_back(s); 
+			else
+				pruned++;
+		}
+	}
+	return pruned;
+}
+
 /**
  * Generate the next level candiates from the current level frequent itemsets.
  * Uses Fk-1 Fk-1 merge. Assumes that each frequent item is ordered lexicographically.
  * Also assumes that the sequence of itemsets are ordered lexicographically.
- * @param out_C [out_param] the candidate itemsets to generate 
- * @param f_set the frequent itemsets from which to create the candidates. Assumes f_set not empty.
+ * The k-subsets of every candidate are looked up in a hash index of f_set. For k>1 the prefix equivalence classes,
+ * i.e., the runs of itemsets sharing their first k-1 items, are split between the worker threads and
+ * their candidates are concatenated in order, so the output does not depend on the number of threads.
+ * @param out_C   [out_param] the candidate itemsets to generate 
+ * @param f_set   the frequent itemsets from which to create the candidates. Assumes f_set not empty.
+ * @param threads the number of worker threads
+ * @return        the number of candidates dropped because one of their k-subsets is not in f_set
  */
-void apriori_gen(Itemsets &out_C, const Itemsets &f_set) {
-#ifdef _DEBUG
-	delete_counter=0;
-#endif
-
+int apriori_gen(Itemsets &out_C, const Itemsets &f_set, int threads) {
 	int k = f_set.back().size();
-	if (k == 1) // special efficient case for merging 1-itemsets
+	if (k == 1) { // special efficient case for merging 1-itemsets
 		for (auto it1=f_set.begin(); it1!=f_set.end()-1; it1++)
 			for (auto it2=it1+1; it2!=f_set.end(); it2++) {
 				out_C.push_back( Itemset({it1->back(), it2->back()}) );
 			}
-	else // merge frequent k-itemsets to get (k+1)-itemsets, k>1
-		for (int i=0, f_sz = (int) f_set.size(); i!=f_sz; i++) {
-			const Itemset& s1=f_set[i];		
-			for (int j=i+1; j<f_sz; j++)
-				if (std::equal(s1.begin(), s1.end()-1, f_set[j].begin())) {
-					do {
-						/* create the candidate */
-						Itemset s(s1);
-						s.push_back(f_set[j].back());
-
-						/* level-wise pruning trick: check if all k-itemset subsets of s are contained in f_set   */
-						bool to_add = true;
-						int s_sz = (int) s.size();
-						for (int m, ii=s_sz-1; ii>=0; ii--) { // ii corresponds to the index of the removed element in s to create k-itemset
-							for (m=i; m<f_sz; m++) {
-
-								const Itemset& fm = f_set[m];
-								if ( !std::equal(s.begin(), s.begin()+ii, fm.begin()) ) { 
-									m=f_sz;
-									break;
-								}
-								else if ( std::equal(s.begin()+ii+1, s.end(), fm.begin()+ii) )
-									break;
-							
-							}
-							if (m>=f_sz) {// did not find a match
-								to_add = false;
-								break;	
-							}
-						}
-
-						/* add candidate to the set of all candidates */
-						if (to_add)
-							out_C.push_back(s); 
-#ifdef _DEBUG
-						else
-							delete_counter++;
-#endif
-					} while (++j<f_sz && s1[k-2]==f_set[j][k-2]);
-				}
+		return 0;
+	}
+
+	/* merge frequent k-itemsets to get (k+1)-itemsets, k>1 */
+	int f_sz = (int) f_set.size();
+	ItemsetIndex index(f_sz);
+	for (const Itemset &s : f_set)
+		index.insert(&s);
+
+	/* the bounds of the prefix equivalence classes, and the merges done by the classes before each bound */
+	std::vector<int> bound(1, 0);
+	std::vector<double> work(1, 0);
+	for (int i=1; i<=f_sz; i++)
+		if (i == f_sz || !std::equal(f_set[i].begin(), f_set[i].end()-1, f_set[i-1].begin())) {
+			double c_sz = i-bound.back();
+			work.push_back(work.back() + c_sz*(c_sz-1)/2);
+			bound.push_back(i);
+		}
+
+	/* split the classes into contiguous ranges of about the same work */
+	int classes = (int) bound.size()-1;
+	threads = std::max(1, std::min(threads, classes));
+	std::vector<int> split(1, 0);
+	for (int c=1, w=1; c<classes && w<threads; c++)
+		if (work[c] >= work.back()*w/threads) {
+			split.push_back(c);
+			w++;
+		}
+	split.push_back(classes);
+
+	int parts = (int) split.size()-1;
+	std::vector<Itemsets> part_C(parts);
+	std::vector<int> pruned(parts, 0);
+	auto gen = [&](int p) {
+		pruned[p] = merge_classes(part_C[p], f_set, index, bound[ split[p] ], bound[ split[p+1] ]);
+	};
+	if (parts == 1)
+		gen(0);
+	else {
+		std::vector<std::thread> workers;
+		for (int p=0; p<parts; p++)
+			workers.push_back( std::thread(gen, p) );
+		for (std::thread &worker : workers)
+			worker.join();
+	}
+
+	/* concatenate the candidates in order */
+	size_t c_sz = out_C.size();
+	for (Itemsets &C : part_C)
+		c_sz += C.size();
+	out_C.reserve(c_sz);
+	for (Itemsets &C : part_C)
+		std::move(C.begin(), C.end(), std::back_inserter(out_C));
+	int total_pruned = 0;
+	for (int p : pruned)
+		total_pruned += p;
+	return total_pruned;
+}
+
+/* number of frequent itemsets a worker claims at a time when generating rules */
+#define RULE_BLOCK 64
+
+/* generates the rules of an itemset on a worker */
+typedef std::function<void(Rules &rules, const Itemset &fk, int worker)> RuleGen;
+
+/**
+ * Generates the rules of the itemsets with gen.
+ * The itemsets are split into blocks which are claimed by the worker threads. Every block writes
+ * its rules into its own buffer and the buffers are appended in order, so the rules are in the same order
+ * for any number of threads. With a sink the buffers are instead handed to it in the same order as soon as
+ * they are complete and then freed, so the rules can be written while later blocks are still being generated.
+ * @param rules   [out_param] the found rules
+ * @param fsets   the itemsets
+ * @param gen     generates the rules of an itemset into a buffer
+ * @param threads the number of worker threads
+ * @param sink    if set, receives the rules block by block and rules stays empty
+ */
+static void generate_rules(Rules &rules, const std::vector<const Itemset*> &fsets, const RuleGen &gen, int threads, const RuleSink &sink) {
+	rules.clear();
+	int n = (int) fsets.size(), blocks = (n+RULE_BLOCK-1)/RULE_BLOCK;
+	threads = std::max(1, std::min(threads, blocks));
+	std::vector<Rules> buffers(blocks);
+	std::atomic<int> next(0);
+
+	/* with a sink, finished blocks are handed over in block order as soon as all earlier ones are done */
+	std::mutex emit_lock;
+	std::vector<char> done(blocks, 0);
+	int next_emit = 0;
+	auto emit = [&](int b) {
+		std::lock_guard<std::mutex> lock(emit_lock);
+		done[b] = 1;
+		for (; next_emit<blocks && done[next_emit]; next_emit++) {
+			sink(buffers[next_emit]);
+			buffers[next_emit] = Rules();
 		}
+	};
+
+	auto work = [&](int w) {
+		for (int b; (b = next.fetch_add(1)) < blocks; ) {
+			for (int x=b*RULE_BLOCK; x<n && x<(b+1)*RULE_BLOCK; x++)
+				gen(buffers[b], *fsets[x], w);
+			if (sink)
+				emit(b);
+		}
+	};
+
+	if (threads == 1)
+		work(0);
+	else {
+		std::vector<std::thread> workers;
+		for (int w=0; w<threads; w++)
+			workers.push_back( std::thread(work, w) );
+		for (std::thread &worker : workers)
+			worker.join();
+	}
+
+	if (!sink)
+		for (Rules &buffer : buffers)
+			rules.append(buffer);
 }
 
 /**
- * Get the rules corresponding to the provided frequent itemsets
+ * Get the rules corresponding to the provided frequent itemsets, see generate_rules
  * @param rules   [out_param] the found rules
  * @param sigma 	the support count of itemsets
  * @param F       the frequent itemsets found using apriori
  * @param minconf the minimum confidence which the rules have to meet
+ * @param threads the number of worker threads
+ * @param sink    if set, receives the rules block by block and rules stays empty
  */
-void get_rules(Rules &rules, const SupportCountTable &sigma, const std::vector<Itemsets> &F, const float minconf) {
-	rules.clear();
-	/* for each k-itemset, k>=2 */
-	for (auto it=F.begin()+1; it!=F.end(); it++)
-		for (Itemset fk : *it) {
-			/* create possible 1-item consequents from the items of fk and push into H */
-			Itemsets H;
-			for (Item i : fk)
-				H.push_back( Itemset({i}) );
+void get_rules(Rules &rules, const SupportCountTable &sigma, const std::vector<Itemsets> &F, const float minconf, int threads, const RuleSink &sink) {
+	get_rules(rules, SupportIndex(F, sigma), F, minconf, threads, sink);
+}
+
+/**
+ * Get the rules corresponding to the provided frequent itemsets, see above.
+ * @param support the support counts of the itemsets of F, e.g., as loaded from an itemset index
+ */
+void get_rules(Rules &rules, const SupportIndex &support, const std::vector<Itemsets> &F, const float minconf, int threads, const RuleSink &sink) {
+	/* all k-itemsets, k>=2 */
+	std::vector<const Itemset*> fsets;
+	for (size_t k=1; k<F.size(); k++)
+		for (const Itemset &fk : F[k])
+			fsets.push_back(&fk);
+
+	generate_rules(rules, fsets, [&](Rules &out, const Itemset &fk, int) {
+		/* create possible 1-item consequents from the items of fk and push into H */
+		Itemsets H;
+		for (Item i : fk)
+			H.push_back( Itemset({i}) );
+
+		/* get rules for fk */
+		ap_genrules(out, support, fk, H, minconf);
+	}, threads, sink);
+}
+
+/**
+ * Get the rules between the closed frequent itemsets, i.e., X => Z\X for every closed itemset X and every closed
+ * itemset Z which is a proper superset of X, in the order of X in F. The support and confidence of any other rule
+ * follow from these, since the support of an itemset is that of its closed supersets with the highest support.
+ * A Z has a support below X's and reaches minconf only if its support is at least minconf times X's, so only the
+ * closed itemsets in that range which hold the item of X with the fewest of them are looked at.
+ * @param rules   [out_param] the found rules
+ * @param sigma 	the support count of the closed itemsets
+ * @param F       the closed frequent itemsets, see eclat_condensed
+ * @param minconf the minimum confidence which the rules have to meet
+ * @param threads the number of worker threads
+ * @param sink    if set, receives the rules block by block and rules stays empty
+ */
+void get_closed_rules(Rules &rules, const SupportCountTable &sigma, const std::vector<Itemsets> &F, const float minconf, int threads, const RuleSink &sink) {
+	/* number the closed itemsets and list those holding every item by increasing support */
+	std::vector<const Itemset*> sets;
+	std::vector<int> sup;
+	Item max_item = -1;
+	for (const Itemsets &Fk : F)
+		for (const Itemset &s : Fk) {
+			sets.push_back(&s);
+			sup.push_back(sigma.at(s));
+			max_item = std::max(max_item, s.back());
+		}
+	std::vector< std::vector<int> > holding(max_item+1);
+	for (int id=0; id<(int) sets.size(); id++)
+		for (Item i : *sets[id])
+			holding[i].push_back(id);
+	for (std::vector<int> &ids : holding)
+		std::stable_sort(ids.begin(), ids.end(), [&sup](int a, int b) { return sup[a] < sup[b]; });
+
+	generate_rules(rules, sets, [&](Rules &out, const Itemset &x, int) {
+		int x_sup = sigma.at(x);
+		double min_sup = (double) x_sup*minconf*(1-1e-6);
+		auto below = [&sup](int id, double s) { return sup[id] < s; };
 
-			/* get rules for fk */
-			ap_genrules(rules, sigma, fk, H, minconf);
+		/* the supersets in the support range holding the item of x with the fewest of them */
+		std::vector<int>::const_iterator first, last;
+		size_t fewest = SIZE_MAX;
+		for (Item i : x) {
+			const std::vector<int> &ids = holding[i];
+			auto lo = std::lower_bound(ids.begin(), ids.end(), min_sup, below);
+			auto hi = std::lower_bound(lo, ids.end(), (double) x_sup, below);
+			if ((size_t) (hi-lo) < fewest) {
+				fewest = (size_t) (hi-lo);
+				first = lo;
+				last = hi;
+			}
+		}
+
+		Itemset dif;
+		for (auto it=first; it!=last; ++it) {
+			const Itemset &z = *sets[*it];
+			float conf = (float) sup[*it]/(float) x_sup;
+			if (conf >= minconf && std::includes(z.begin(), z.end(), x.begin(), x.end())) {
+				dif.resize(z.size());
+				size_t dif_sz = std::set_difference(z.begin(), z.end(), x.begin(), x.end(), dif.begin()) - dif.begin();
+				out.add(x.data(), x.size(), dif.data(), dif_sz, sup[*it], conf);
+			}
 		}
+	}, threads, sink);
 }
 
 /**
  * Generates the rules with the given input frequent k-itemset, k>=2
  * @param rules   [out_param] the generated rules
- * @param sigma   the support count of evrey frequent itemset
+ * @param support the support count of evrey frequent itemset
  * @param fk      the frequent itemset for which we generate the rules
  * @param H       the candidate m-itemsets for the rule-consequent, k>m>=1
  * @param minconf the minimum acceptable confidence
  */
-void ap_genrules(Rules &rules, const SupportCountTable &sigma, Itemset& fk, Itemsets& H, const float minconf) {
-	int sup;
+void ap_genrules(Rules &rules, const SupportIndex &support, const Itemset& fk, const Itemsets& H, const float minconf) {
 	if (fk.size() > H.back().size()) {
-		for (auto iter=H.begin(); iter!=H.end(); ) {
-			Itemset& h=*iter, dif;
-			std::set_difference(fk.begin(), fk.end(), h.begin(), h.end(), std::back_inserter(dif));
-			/* dif subset of fk and fk is frequent so sigma.at(dif) is not 0 */
-			float conf = (float)( sup=sigma.at(fk) )/(float)sigma.at(dif);
+		int sup = support(fk.data(), fk.size());
+		Itemsets kept_H;
+		Itemset dif(fk.size());
+		for (const Itemset &h : H) {
+			size_t dif_sz = std::set_difference(fk.begin(), fk.end(), h.begin(), h.end(), dif.begin()) - dif.begin();
+			/* dif subset of fk and fk is frequent so its support is not 0 */
+			float conf = (float) sup/(float) support(dif.data(), dif_sz);
 			if (conf >= minconf) {
-				rules.push_back( Rule(dif, h, sup, conf) );
-				iter++; // only move forward if we didn't erase anything
-			}
-			else {
-				iter = H.erase(iter);
+				rules.add(dif.data(), dif_sz, h.data(), h.size(), sup, conf);
+				kept_H.push_back(h);
 			}
 		}
-		if (H.size() > 0) {
+		if (kept_H.size() > 0) {
 			Itemsets next_H;
-			apriori_gen(next_H, H);
+			apriori_gen(next_H, kept_H);
 			if (next_H.size() > 0)
-				ap_genrules(rules, sigma, fk, next_H, minconf);			
+				ap_genrules(rules, support, fk, next_H, minconf);			
 		}
 	}
 }
 
+/**
+ * Keeps the frequent itemsets which reach a higher minimum support, so that one mining run serves several minsups.
+ * The itemsets keep their order and sigma still holds their support counts. Empty trailing levels are dropped.
+ * @param out_F  [out_param] the itemsets of F with a support count of at least minsup
+ * @param F      the frequent itemsets at a minsup of at most minsup
+ * @param sigma  the support counts of the itemsets of F
+ * @param minsup the minimum support count
+ */
+void filter_frequent(std::vector<Itemsets> &out_F, const std::vector<Itemsets> &F, const SupportCountTable &sigma, const int minsup) {
+	out_F.assign(F.size(), Itemsets());
+	for (size_t k=0; k<F.size(); k++)
+		for (const Itemset &s : F[k])
+			if (sigma.at(s) >= minsup)
+				out_F[k].push_back(s);
+	while (!out_F.empty() && out_F.back().empty())
+		out_F.pop_back();
+}
+
+/**
+ * Keeps the closed or the maximal itemsets of all frequent itemsets, i.e., those without a superset of the same
+ * support or without any frequent superset. It is enough to look at the supersets with one more item.
+ * @param out_F   [out_param] the closed or maximal itemsets of F, in the same order
+ * @param F       all frequent itemsets
+ * @param sigma   the support counts of the itemsets of F
+ * @param maximal whether to keep the maximal instead of the closed itemsets
+ */
+void filter_condensed(std::vector<Itemsets> &out_F, const std::vector<Itemsets> &F, const SupportCountTable &sigma, const bool maximal) {
+	out_F.assign(F.size(), Itemsets());
+	for (size_t k=0; k<F.size(); k++) {
+		std::unordered_set<Itemset, ItemsetHash> covered;
+		if (k+1 < F.size())
+			for (const Itemset &s : F[k+1]) {
+				int sup = sigma.at(s);
+				for (size_t drop=0; drop<s.size(); drop++) {
+					Itemset sub(s);
+					sub.erase(sub.begin()+drop);
+					if (maximal || sigma.at(sub) == sup)
+						covered.insert(std::move(sub));
+				}
+			}
+		for (const Itemset &s : F[k])
+			if (!covered.count(s))
+				out_F[k].push_back(s);
+	}
+}
+
 /**
  * Prune the data base of any transactions which do not contain frequent itemsets
  * @param T  The database to prune
  * @param Fk All frequent k-itemsets
+ * @return   The number of removed transactions
  */
-void prune_db(DB& T, const Itemsets& Fk) {
-	/* Prune those transactions which do not contain frequent itemsets */
+int prune_db(DB& T, const Itemsets& Fk) {
+	/* Prune those transactions which do not contain frequent itemsets, compacting T once */
 	int k = (int) Fk.back().size();
-	for (auto it=T.begin(); it!=T.end();) {
-		bool prune = true;
-		if (k <= (int)it->size())
+	std::vector<char> keep(T.size(), 0);
+	for (size_t x=0; x<T.size(); x++) {
+		Transaction t = T[x];
+		if (k <= (int) t.size())
 			for (const Itemset& s : Fk)
-				if ( std::includes(it->begin(), it->end(), s.begin(), s.end()) ) {
-					prune = false;
+				if ( std::includes(t.begin(), t.end(), s.begin(), s.end()) ) {
+					keep[x] = 1;
 					break;
 				}
-		if (prune)
-			it = T.erase(it);
-		else
-			it++;
 	}
+	return (int) T.compact(keep);
 }
\ No newline at end of file
@@ -5,12 +5,48 @@
 #include "params.hpp"
 #include "types.hpp"
 
+#include <functional>
 #include <vector>
 
-void apriori(SupportCountTable &sigma, std::vector<Itemsets> &F, DB &T, const Params &params, const Item maxitem);
-void apriori_gen(Itemsets &C, const Itemsets &f_set);
-void get_rules(Rules &rules, const SupportCountTable &sigma, const std::vector<Itemsets> &F, const float minconf);
-void ap_genrules(Rules &rules, const SupportCountTable &sigma, Itemset& fk, Itemsets& H, const float minconf);
-void prune_db(DB& T, const Itemsets& Fk);
+class HashTree;
+struct MiningStats;
+
+typedef std::function<void(const Rules&)> RuleSink;
+
+/**
+ * The support counts of all pairs of the dense item codes [0, m) in an upper-triangular array.
+ * Row a holds the pairs (a, a+1), ..., (a, m-1), so the pair (a, b), a<b, is counted in cell(a, b).
+ */
+class PairCounts {
+	std::vector<size_t> row;
+	std::vector<int> tri;
+public:
+	PairCounts(const int m = 0) : row(m) {
+		for (int a=0; a<m; a++)
+			row[a] = (size_t) a*(2*(size_t)m-a-1)/2;
+		tri.assign(m? row[m-1]: 0, 0);
+	}
+
+	int size() const { return (int) row.size(); }
+	size_t cells() const { return tri.size(); }
+	size_t cell(const int a, const int b) const { return row[a]+b-a-1; }
+	int operator[](const size_t c) const { return tri[c]; }
+	int operator()(const int a, const int b) const { return tri[ cell(a, b) ]; }
+
+	void count(const DB &T, const std::vector<int> &code, int threads);
+};
+
+void apriori(SupportCountTable &sigma, std::vector<Itemsets> &F, DB &T, const Params &params, const Item maxitem, MiningStats *stats = NULL);
+int apriori_top(SupportCountTable &sigma, std::vector<Itemsets> &F, DB &T, const Params &params, const Item maxitem);
+int count_support(std::vector<int> &counts, DB &T, const HashTree &hash_tree, int threads, const bool erase = true);
+void count_levels(std::vector<int> &item_counts, std::vector< std::vector<int> > &counts, const DB &T, const std::vector<Itemsets> &C, const Params &params);
+int apriori_gen(Itemsets &C, const Itemsets &f_set, int threads = 1);
+void get_rules(Rules &rules, const SupportCountTable &sigma, const std::vector<Itemsets> &F, const float minconf, int threads = 1, const RuleSink &sink = RuleSink());
+void get_rules(Rules &rules, const SupportIndex &support, const std::vector<Itemsets> &F, const float minconf, int threads = 1, const RuleSink &sink = RuleSink());
+void get_closed_rules(Rules &rules, const SupportCountTable &sigma, const std::vector<Itemsets> &F, const float minconf, int threads = 1, const RuleSink &sink = RuleSink());
+void ap_genrules(Rules &rules, const SupportIndex &support, const Itemset& fk, const Itemsets& H, const float minconf);
+void filter_frequent(std::vector<Itemsets> &out_F, const std::vector<Itemsets> &F, const SupportCountTable &sigma, const int minsup);
+void filter_condensed(std::vector<Itemsets> &out_F, const std::vector<Itemsets> &F, const SupportCountTable &sigma, const bool maximal);
+int prune_db(DB& T, const Itemsets& Fk);
 
 #endif
\ No newline at end of file
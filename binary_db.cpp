@@ -0,0 +1,186 @@
+#include "binary_db.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedDB::MappedDB() : data(NULL), length(0), header(NULL), offsets(NULL), items(NULL), freq(NULL) {}
+
+MappedDB::~MappedDB() {
+	close();
+}
+
+/**
+ * Maps the binary transaction file into memory and checks that its sections fit the file.
+ * @param  fn The binary file
+ * @return    True if the file was mapped. False otherwise.
+ */
+bool MappedDB::open(const std::string& fn) {
+	close();
+	int fd = ::open(fn.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(BinaryDBHeader)) {
+		::close(fd);
+		return false;
+	}
+	length = (size_t) st.st_size;
+	data = mmap(NULL, length, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED) {
+		data = NULL;
+		return false;
+	}
+	madvise(data, length, MADV_SEQUENTIAL);
+
+	header = (const BinaryDBHeader*) data;
+	size_t expected = sizeof(BinaryDBHeader) + (header->num_transactions+1)*sizeof(uint64_t) + header->num_occurrences*sizeof(int32_t);
+	if (header->flags & BINARY_DB_FREQ)
+		expected += (size_t) (header->max_item+1)*sizeof(int32_t);
+	if (std::memcmp(header->magic, BINARY_DB_MAGIC, sizeof(header->magic)) || expected != length) {
+		close();
+		return false;
+	}
+
+	offsets = (uint64_t*) (header+1);
+	items = (int32_t*) (offsets+header->num_transactions+1);
+	freq = (header->flags & BINARY_DB_FREQ)? items+header->num_occurrences: NULL;
+	return true;
+}
+
+/**
+ * Unmaps the file
+ */
+void MappedDB::close() {
+	if (data)
+		munmap(data, length);
+	data = NULL;
+	length = 0;
+	header = NULL;
+	offsets = NULL;
+	items = freq = NULL;
+}
+
+/**
+ * Checks whether the file starts with the binary transaction format magic
+ */
+bool is_binary_db(const std::string& fn) {
+	char magic[8] = {0};
+	FILE *in = fopen(fn.c_str(), "rb");
+	if (!in)
+		return false;
+	size_t n = fread(magic, 1, sizeof(magic), in);
+	fclose(in);
+	return n == sizeof(magic) && !std::memcmp(magic, BINARY_DB_MAGIC, sizeof(magic));
+}
+
+/**
+ * Opens the output file and reserves the header and offsets.
+ * The offsets are written through one handle from the front and the items through a second one behind the offsets.
+ * @param fn               The output file
+ * @param num_transactions The number of transactions that will be added
+ */
+BinaryDBWriter::BinaryDBWriter(const std::string& fn, const uint64_t num_transactions) :
+		num_transactions(num_transactions), added(0), num_occurrences(0) {
+	offsets_out = fopen(fn.c_str(), "wb");
+	items_out = offsets_out? fopen(fn.c_str(), "r+b"): NULL;
+	if (!items_out) {
+		printf("incorrent output filename \'%s\'\n", fn.c_str());
+		exit(1);
+	}
+
+	BinaryDBHeader header;
+	std::memset(&header, 0, sizeof(header));
+	fwrite(&header, sizeof(header), 1, offsets_out);
+	fwrite(&num_occurrences, sizeof(uint64_t), 1, offsets_out);
+	fseek(items_out, sizeof(BinaryDBHeader) + (num_transactions+1)*sizeof(uint64_t), SEEK_SET);
+}
+
+BinaryDBWriter::~BinaryDBWriter() {
+	if (offsets_out)
+		close(true);
+}
+
+/**
+ * Appends the next transaction
+ * @param items The items of the transaction, sorted increasingly
+ * @param n     The number of items
+ */
+void BinaryDBWriter::add(const Item *items, const size_t n) {
+	if (added++ == num_transactions) {
+		printf("more transactions written than announced\n");
+		exit(1);
+	}
+	fwrite(items, sizeof(int32_t), n, items_out);
+	num_occurrences += n;
+	fwrite(&num_occurrences, sizeof(uint64_t), 1, offsets_out);
+	for (size_t x=0; x<n; x++) {
+		if (items[x] >= (Item) freq.size())
+			freq.resize(items[x]+1, 0);
+		freq[ items[x] ]++;
+	}
+}
+
+/**
+ * Writes the item frequencies and the header and closes the file
+ * @param with_freq Whether to append the support count of every item
+ */
+void BinaryDBWriter::close(const bool with_freq) {
+	if (added != num_transactions) {
+		printf("%llu transactions written but %llu announced\n", (unsigned long long) added, (unsigned long long) num_transactions);
+		exit(1);
+	}
+	if (with_freq)
+		fwrite(freq.data(), sizeof(int32_t), freq.size(), items_out);
+	fclose(items_out);
+
+	BinaryDBHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, BINARY_DB_MAGIC, sizeof(header.magic));
+	header.flags = with_freq? BINARY_DB_FREQ: 0;
+	header.max_item = (int32_t) freq.size()-1;
+	header.num_transactions = num_transactions;
+	header.num_occurrences = num_occurrences;
+	fseek(offsets_out, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, offsets_out);
+	fclose(offsets_out);
+	offsets_out = items_out = NULL;
+}
+
+/**
+ * Writes the transactions in the binary transaction format.
+ * @param fn        The output file
+ * @param db        The sorted transactions
+ * @param with_freq Whether to append the support count of every item
+ */
+void write_binary_db(const std::string& fn, const DB& db, const bool with_freq) {
+	BinaryDBWriter writer(fn, db.size());
+	for (const Transaction &t : db)
+		writer.add(t.begin(), t.size());
+	writer.close(with_freq);
+}
+
+/**
+ * Loads the transactions of a binary transaction file through a memory mapping.
+ * The DB uses the mapped arrays directly, so nothing is parsed, sorted or copied.
+ * @param  fn      The binary file
+ * @param  out_db [out param] The transactions
+ * @return         The largest item found.
+ */
+int read_binary_db(const std::string& fn, DB& out_db) {
+	std::shared_ptr<MappedDB> mapped(new MappedDB());
+	if (!mapped->open(fn)) {
+		printf("corrupt binary input file \'%s\'\n", fn.c_str());
+		exit(1);
+	}
+
+	out_db.adopt(mapped, mapped->offsets, mapped->items, (size_t) mapped->header->num_transactions);
+	return mapped->header->max_item;
+}
@@ -0,0 +1,66 @@
+#ifndef _BINARY_DB_HPP
+#define _BINARY_DB_HPP
+
+#include "types.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#define BINARY_DB_MAGIC "HCRCSR1"
+#define BINARY_DB_FREQ 1 // header flag: the file ends with the support count of every item
+
+/**
+ * Header of the binary transaction format. It is followed by
+ *   uint64_t offsets[num_transactions+1]  transaction x holds items[offsets[x], offsets[x+1])
+ *   int32_t  items[num_occurrences]       the items of every transaction, sorted increasingly
+ *   int32_t  freq[max_item+1]             if flags has BINARY_DB_FREQ, the number of transactions containing every item
+ */
+struct BinaryDBHeader {
+	char magic[8];
+	uint32_t flags;
+	int32_t max_item;
+	uint64_t num_transactions;
+	uint64_t num_occurrences;
+};
+
+/**
+ * A private memory mapping of a binary transaction file.
+ * Writes to the mapping, e.g., when a DB compacts its transactions, are never written back to the file.
+ */
+class MappedDB {
+	void *data;
+	size_t length;
+public:
+	const BinaryDBHeader *header;
+	uint64_t *offsets;
+	int32_t *items;
+	int32_t *freq; // NULL if the file has no item frequencies
+
+	MappedDB();
+	~MappedDB();
+	bool open(const std::string& fn);
+	void close();
+};
+
+/**
+ * Writes a binary transaction file one transaction at a time, so the transactions never have to be held in memory.
+ * The number of transactions must be known up front, since the offsets precede the items.
+ */
+class BinaryDBWriter {
+	FILE *offsets_out, *items_out;
+	uint64_t num_transactions, added, num_occurrences;
+	std::vector<int32_t> freq;
+public:
+	BinaryDBWriter(const std::string& fn, const uint64_t num_transactions);
+	~BinaryDBWriter();
+	void add(const Item *items, const size_t n);
+	void close(const bool with_freq);
+};
+
+bool is_binary_db(const std::string& fn);
+void write_binary_db(const std::string& fn, const DB& db, const bool with_freq);
+int read_binary_db(const std::string& fn, DB& out_db);
+
+#endif
@@ -0,0 +1,395 @@
+#include "eclat.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+/* an item's tids are kept as a bitset when at least 1 in DENSE_RATIO transactions contain it */
+#define DENSE_RATIO 32
+
+/**
+ * The transactions containing an itemset, i.e., its tid-list.
+ * Dense lists are a bitset over all transactions, sparse lists are the sorted tids.
+ */
+struct TidList {
+	bool dense;
+	int support;
+	std::vector<uint64_t> bits;
+	std::vector<int> tids;
+};
+
+/**
+ * Chooses the representation of a tid-list with the given support by its density.
+ */
+static bool is_dense(const int support, const int n) {
+	return (long long) support*DENSE_RATIO >= n;
+}
+
+/**
+ * Converts the sorted tids to a bitset over n transactions.
+ */
+static void to_bits(TidList &l, const std::vector<int> &tids, const int n) {
+	l.bits.assign((n+63)/64, 0);
+	for (int tid : tids)
+		l.bits[tid>>6] |= (uint64_t) 1 << (tid&63);
+}
+
+/**
+ * Intersects two tid-lists.
+ * Bitsets are intersected with a word-wise AND and counted with popcount.
+ * A sparse list is intersected with a bitset by testing each of its tids.
+ * @param out [out_param] the intersection
+ * @param a   the first tid-list
+ * @param b   the second tid-list
+ * @param n   the number of transactions
+ */
+static void intersect(TidList &out, const TidList &a, const TidList &b, const int n) {
+	out.bits.clear();
+	out.tids.clear();
+	if (a.dense && b.dense) {
+		size_t words = a.bits.size();
+		out.bits.resize(words);
+		int support = 0;
+		for (size_t w=0; w<words; w++)
+			support += __builtin_popcountll( out.bits[w] = a.bits[w] & b.bits[w] );
+		out.support = support;
+		out.dense = is_dense(support, n);
+		if (!out.dense) { // too sparse, so switch to the tids
+			out.tids.reserve(support);
+			for (size_t w=0; w<words; w++)
+				for (uint64_t word=out.bits[w]; word; word &= word-1)
+					out.tids.push_back( (int) (w<<6) + __builtin_ctzll(word) );
+			std::vector<uint64_t>().swap(out.bits);
+		}
+		return;
+	}
+
+	if (!a.dense && !b.dense)
+		std::set_intersection(a.tids.begin(), a.tids.end(), b.tids.begin(), b.tids.end(), std::back_inserter(out.tids));
+	else {
+		const TidList &sparse = a.dense? b: a, &dense = a.dense? a: b;
+		for (int tid : sparse.tids)
+			if ( (dense.bits[tid>>6] >> (tid&63)) & 1 )
+				out.tids.push_back(tid);
+	}
+	out.support = (int) out.tids.size();
+	out.dense = false; // a subset of a sparse list is sparse
+}
+
+/**
+ * Mines the frequent itemsets of an equivalence class depth-first.
+ * Every member of the class is prefix plus one item and the members are ordered increasingly by that item,
+ * so the itemsets of each size are found in lexicographical order.
+ * @param sigma  [out_param] the support counts of the frequent itemsets
+ * @param F      [out_param] the frequent itemsets, by size
+ * @param prefix the itemset shared by the class members
+ * @param items  the item extending the prefix for every class member
+ * @param lists  the tid-list of every class member
+ * @param minsup the minimum support count
+ * @param n      the number of transactions
+ */
+static void mine_class(SupportCountTable &sigma, std::vector<Itemsets> &F, Itemset &prefix,
+		const std::vector<Item> &items, const std::vector<TidList> &lists, const int minsup, const int n) {
+	int c_sz = (int) items.size();
+	for (int i=0; i<c_sz; i++) {
+		prefix.push_back(items[i]);
+
+		/* record the member */
+		if (F.size() < prefix.size())
+			F.push_back(Itemsets());
+		F[prefix.size()-1].push_back(prefix);
+		sigma[prefix] = lists[i].support;
+
+		/* build the class of the member */
+		std::vector<Item> next_items;
+		std::vector<TidList> next_lists;
+		TidList l;
+		for (int j=i+1; j<c_sz; j++) {
+			intersect(l, lists[i], lists[j], n);
+			if (l.support >= minsup) {
+				next_items.push_back(items[j]);
+				next_lists.push_back(std::move(l));
+				l = TidList();
+			}
+		}
+		if (!next_items.empty())
+			mine_class(sigma, F, prefix, next_items, next_lists, minsup, n);
+
+		prefix.pop_back();
+	}
+}
+
+/**
+ * Builds the tid-list of every frequent item with one scan of the transactions
+ * @param items [out_param] the frequent items, increasingly
+ * @param lists [out_param] the tid-list of every frequent item
+ * @param T     all transactions
+ * @param minsup the minimum support count
+ * @param maxitem the largest item found in all transactions
+ */
+static void item_lists(std::vector<Item> &items, std::vector<TidList> &lists, const DB &T, const int minsup, const Item maxitem) {
+	int n = (int) T.size();
+	std::vector< std::vector<int> > tids(maxitem+1);
+	int tid = 0;
+	for (const Transaction &t : T) {
+		for (Item i : t)
+			tids[i].push_back(tid);
+		tid++;
+	}
+
+	for (Item item=0; item<=maxitem; item++) {
+		int support = (int) tids[item].size();
+		if (support >= minsup) {
+			TidList l;
+			l.support = support;
+			l.dense = is_dense(support, n);
+			if (l.dense)
+				to_bits(l, tids[item], n);
+			else
+				l.tids.swap(tids[item]);
+			items.push_back(item);
+			lists.push_back(std::move(l));
+		}
+		std::vector<int>().swap(tids[item]);
+	}
+}
+
+/**
+ * Finds the frequent itemsets with the vertical Eclat algorithm.
+ * The transactions are scanned once to build the tid-list of every frequent item, after which
+ * all supports are computed by intersecting tid-lists. Produces the same F and sigma as apriori.
+ * @param sigma  	[out_parameter] the support counts for all itemsets
+ * @param F      	[out_parameter] a vector of frequent itemsets where F[k] is the vector of all frequent k-itemsets
+ * @param T      	all transactions
+ * @param params 	the parameters used, i.e., minsup
+ * @param maxitem the largest item found in all transactions
+ */
+void eclat(SupportCountTable &sigma, std::vector<Itemsets> &F, const DB &T, const Params &params, const Item maxitem) {
+	/* clean slate */
+	F.clear();
+	F.push_back(Itemsets());
+
+	/* the frequent items form the class of the empty prefix */
+	std::vector<Item> items;
+	std::vector<TidList> lists;
+	item_lists(items, lists, T, params.minsup, maxitem);
+
+	Itemset prefix;
+	mine_class(sigma, F, prefix, items, lists, params.minsup, (int) T.size());
+}
+
+/**
+ * The itemsets found by the closed or maximal search, with an index to tell whether a new itemset is subsumed
+ * by one of them. Closed itemsets are indexed by their support and tid sum, maximal ones by every item they hold.
+ */
+struct Condensed {
+	std::vector<Itemset> sets;
+	std::vector<int> support;
+	std::unordered_map< uint64_t, std::vector<int> > index;
+
+	/**
+	 * @return Whether the sorted itemset s is a subset of an itemset in the bucket key
+	 *         with at least the given support
+	 */
+	bool subsumed(const uint64_t key, const Itemset &s, const int min_support) const {
+		auto it = index.find(key);
+		if (it == index.end())
+			return false;
+		for (int id : it->second)
+			if (support[id] >= min_support && std::includes(sets[id].begin(), sets[id].end(), s.begin(), s.end()))
+				return true;
+		return false;
+	}
+
+	void add(Itemset &&s, const int sup) {
+		sets.push_back(std::move(s));
+		support.push_back(sup);
+	}
+};
+
+/**
+ * The sum of the tids of a tid-list, which together with its support tells most tid-lists apart
+ */
+static uint64_t tid_sum(const TidList &l) {
+	uint64_t sum = 0;
+	if (!l.dense) {
+		for (int tid : l.tids)
+			sum += tid;
+		return sum;
+	}
+	for (size_t w=0; w<l.bits.size(); w++)
+		for (uint64_t word=l.bits[w]; word; word &= word-1)
+			sum += (w<<6) + __builtin_ctzll(word);
+	return sum;
+}
+
+/**
+ * Mines the closed frequent itemsets of an equivalence class depth-first with the CHARM algorithm of Zaki and Hsiao.
+ * Extending member i by member j, if every transaction of i holds j, j's item is moved into the prefix of i's
+ * class, and if every transaction of j holds i, j is dropped from this class since all its closed supersets
+ * are found under i. So the branches which can only yield non-closed itemsets are never searched.
+ * An itemset is closed unless a closed itemset found before has the same tid-list.
+ * @param closed  [out_param] the closed itemsets found so far
+ * @param prefix  the itemset shared by the class members
+ * @param items   the item extending the prefix for every class member
+ * @param lists   the tid-list of every class member
+ * @param minsup  the minimum support count
+ * @param n       the number of transactions
+ */
+static void charm(Condensed &closed, const Itemset &prefix, const std::vector<Item> &items, std::vector<TidList> &lists,
+		const int minsup, const int n) {
+	int c_sz = (int) items.size();
+	std::vector<char> dropped(c_sz, 0);
+	for (int i=0; i<c_sz; i++) {
+		if (dropped[i])
+			continue;
+		Itemset X(prefix);
+		X.push_back(items[i]);
+
+		/* build the class of the member, moving the items that always occur with it into its prefix */
+		std::vector<Item> next_items;
+		std::vector<TidList> next_lists;
+		TidList l;
+		for (int j=i+1; j<c_sz; j++) {
+			if (dropped[j])
+				continue;
+			intersect(l, lists[i], lists[j], n);
+			if (l.support < minsup)
+				continue;
+			if (l.support == lists[j].support)
+				dropped[j] = 1;
+			if (l.support == lists[i].support)
+				X.push_back(items[j]);
+			else {
+				next_items.push_back(items[j]);
+				next_lists.push_back(std::move(l));
+				l = TidList();
+			}
+		}
+		if (!next_items.empty())
+			charm(closed, X, next_items, next_lists, minsup, n);
+
+		/* record the member unless a superset with the same tid-list was found */
+		std::sort(X.begin(), X.end());
+		uint64_t key = tid_sum(lists[i])*31 + (uint64_t) lists[i].support;
+		if (!closed.subsumed(key, X, lists[i].support)) {
+			closed.index[key].push_back( (int) closed.sets.size() );
+			closed.add(std::move(X), lists[i].support);
+		}
+		TidList().bits.swap(lists[i].bits); // the tids of a finished member are no longer needed
+		std::vector<int>().swap(lists[i].tids);
+	}
+}
+
+/**
+ * Mines the maximal frequent itemsets of an equivalence class depth-first, as in Gouda and Zaki's GenMax.
+ * A class is skipped if its prefix together with all its items is in a maximal itemset found before.
+ * Extending member i by member j, if every transaction of i holds j, j's item is moved into the prefix of i's class.
+ * A member with an empty class is maximal unless it is in a maximal itemset found before, as every
+ * frequent superset with an earlier item was searched before it.
+ * @param maximal [out_param] the maximal itemsets found so far
+ * @param prefix  the itemset shared by the class members
+ * @param items   the item extending the prefix for every class member
+ * @param lists   the tid-list of every class member
+ * @param minsup  the minimum support count
+ * @param n       the number of transactions
+ */
+static void genmax(Condensed &maximal, const Itemset &prefix, const std::vector<Item> &items, const std::vector<TidList> &lists,
+		const int minsup, const int n) {
+	/* look up a sorted itemset in the maximal itemsets holding its rarest item */
+	auto found = [&maximal](const Itemset &s) {
+		Item rarest = s[0];
+		for (Item i : s)
+			if (maximal.index[i].size() < maximal.index[rarest].size())
+				rarest = i;
+		return maximal.subsumed(rarest, s, 0);
+	};
+
+	Itemset all(prefix);
+	all.insert(all.end(), items.begin(), items.end());
+	std::sort(all.begin(), all.end());
+	if (found(all))
+		return;
+
+	int c_sz = (int) items.size();
+	for (int i=0; i<c_sz; i++) {
+		Itemset X(prefix);
+		X.push_back(items[i]);
+
+		/* build the class of the member, moving the items that always occur with it into its prefix */
+		std::vector<Item> next_items;
+		std::vector<TidList> next_lists;
+		TidList l;
+		for (int j=i+1; j<c_sz; j++) {
+			intersect(l, lists[i], lists[j], n);
+			if (l.support < minsup)
+				continue;
+			if (l.support == lists[i].support)
+				X.push_back(items[j]);
+			else {
+				next_items.push_back(items[j]);
+				next_lists.push_back(std::move(l));
+				l = TidList();
+			}
+		}
+		if (!next_items.empty()) {
+			genmax(maximal, X, next_items, next_lists, minsup, n);
+			continue;
+		}
+
+		std::sort(X.begin(), X.end());
+		if (!found(X)) {
+			for (Item item : X)
+				maximal.index[item].push_back( (int) maximal.sets.size() );
+			maximal.add(std::move(X), lists[i].support);
+		}
+	}
+}
+
+/**
+ * Finds only the closed or only the maximal frequent itemsets, searching the tid-lists as eclat does but skipping
+ * the branches which can't yield such itemsets. An itemset is closed if no superset has the same support and
+ * maximal if no superset is frequent. The support of any frequent itemset is that of its closed supersets with the
+ * highest support, so the closed itemsets keep all supports while the maximal ones only keep which itemsets are frequent.
+ * @param sigma   [out_parameter] the support counts of the found itemsets
+ * @param F       [out_parameter] the found itemsets where F[k] holds those of k+1 items, lexicographically ordered
+ * @param T       all transactions
+ * @param params  the parameters used, i.e., minsup
+ * @param maxitem the largest item found in all transactions
+ * @param maximal whether to find the maximal instead of the closed itemsets
+ */
+void eclat_condensed(SupportCountTable &sigma, std::vector<Itemsets> &F, const DB &T, const Params &params, const Item maxitem, const bool maximal) {
+	F.assign(1, Itemsets());
+
+	/* the frequent items by increasing support, so the classes searched first are the smallest */
+	std::vector<Item> items;
+	std::vector<TidList> lists;
+	item_lists(items, lists, T, params.minsup, maxitem);
+	std::vector<int> order(items.size());
+	for (size_t x=0; x<order.size(); x++)
+		order[x] = (int) x;
+	std::stable_sort(order.begin(), order.end(), [&lists](int a, int b) { return lists[a].support < lists[b].support; });
+	std::vector<Item> sorted_items;
+	std::vector<TidList> sorted_lists;
+	for (int x : order) {
+		sorted_items.push_back(items[x]);
+		sorted_lists.push_back(std::move(lists[x]));
+	}
+
+	Condensed found;
+	Itemset prefix;
+	if (maximal)
+		genmax(found, prefix, sorted_items, sorted_lists, params.minsup, (int) T.size());
+	else
+		charm(found, prefix, sorted_items, sorted_lists, params.minsup, (int) T.size());
+
+	for (size_t x=0; x<found.sets.size(); x++) {
+		size_t k = found.sets[x].size();
+		if (F.size() < k)
+			F.resize(k);
+		sigma[ found.sets[x] ] = found.support[x];
+		F[k-1].push_back( std::move(found.sets[x]) );
+	}
+	for (Itemsets &Fk : F)
+		std::sort(Fk.begin(), Fk.end());
+}
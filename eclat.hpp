@@ -0,0 +1,12 @@
+#ifndef _ECLAT_HPP
+#define _ECLAT_HPP
+
+#include "params.hpp"
+#include "types.hpp"
+
+#include <vector>
+
+void eclat(SupportCountTable &sigma, std::vector<Itemsets> &F, const DB &T, const Params &params, const Item maxitem);
+void eclat_condensed(SupportCountTable &sigma, std::vector<Itemsets> &F, const DB &T, const Params &params, const Item maxitem, const bool maximal);
+
+#endif
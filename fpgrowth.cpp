@@ -0,0 +1,198 @@
+#include "fpgrowth.hpp"
+
+#include <algorithm>
+
+/**
+ * A node of an FP-tree. Nodes refer to each other by their index in the tree's node pool.
+ * item is the rank of the node's item, see fpgrowth.
+ */
+struct FPNode {
+	int item, count;
+	int parent, child, sibling; // the tree structure, -1 if none
+	int link;                   // the next node with the same item, -1 if none
+};
+
+/* the nodes of an FP-tree are allocated in blocks of FP_BLOCK, so growing a large tree never copies all of it */
+#define FP_BLOCK_BITS 16
+#define FP_BLOCK (1<<FP_BLOCK_BITS)
+
+/**
+ * A pool of FP-tree nodes indexed like a vector. It grows block by block instead of reallocating all nodes, so it holds
+ * about as many nodes as are used and never two copies of them.
+ */
+class FPNodePool {
+	std::vector< std::vector<FPNode> > blocks;
+	size_t n;
+public:
+	FPNodePool(const size_t reserve) : blocks(1), n(0) {
+		blocks[0].reserve(std::min(reserve, (size_t) FP_BLOCK));
+	}
+
+	size_t size() const { return n; }
+	FPNode &operator[](const int x) { return blocks[x >> FP_BLOCK_BITS][x & (FP_BLOCK-1)]; }
+	const FPNode &operator[](const int x) const { return blocks[x >> FP_BLOCK_BITS][x & (FP_BLOCK-1)]; }
+
+	void push_back(const FPNode &node) {
+		if (blocks.back().size() == FP_BLOCK) {
+			blocks.push_back(std::vector<FPNode>());
+			blocks.back().reserve(FP_BLOCK);
+		}
+		blocks.back().push_back(node);
+		n++;
+	}
+};
+
+/**
+ * An FP-tree over the items ranked [0, num_items).
+ * All nodes live in a single pool which is grown by the tree, node 0 is the root.
+ * reserve is a bound on the number of nodes, if a tight one is known, which the pool's first block is sized for.
+ */
+class FPTree {
+public:
+	FPNodePool nodes;
+	std::vector<int> head;    // the first node of every item
+	std::vector<int> support; // the support count of every item in the tree
+
+	FPTree(const int num_items, const size_t reserve = 0) : nodes(reserve+1), head(num_items, -1), support(num_items, 0) {
+		nodes.push_back( FPNode{-1, 0, -1, -1, -1, -1} );
+	}
+
+	/**
+	 * Inserts the path of items, ordered increasingly by rank, with the given count.
+	 */
+	void insert(const int *path, const int len, const int count) {
+		int cur = 0;
+		for (int i=0; i<len; i++) {
+			int item = path[i], c;
+			for (c=nodes[cur].child; c!=-1 && nodes[c].item!=item; c=nodes[c].sibling);
+			if (c == -1) {
+				c = (int) nodes.size();
+				nodes.push_back( FPNode{item, 0, cur, -1, nodes[cur].child, head[item]} );
+				nodes[cur].child = c;
+				head[item] = c;
+			}
+			nodes[c].count += count;
+			support[item] += count;
+			cur = c;
+		}
+	}
+};
+
+/**
+ * Records the frequent itemset made of the ranked items in suffix.
+ */
+static void emit(SupportCountTable &sigma, std::vector<Itemsets> &F, const std::vector<int> &suffix,
+		const std::vector<Item> &items, const int sup) {
+	Itemset s;
+	for (int r : suffix)
+		s.push_back(items[r]);
+	std::sort(s.begin(), s.end());
+	while (F.size() < s.size())
+		F.push_back(Itemsets());
+	sigma[s] = sup;
+	F[s.size()-1].push_back( std::move(s) );
+}
+
+/**
+ * Mines the frequent itemsets of the tree, each extended with the suffix.
+ * For every frequent item of the tree its conditional pattern base is collected through the node links
+ * and turned into a conditional FP-tree which is mined recursively.
+ * @param sigma  [out_param] the support counts of the frequent itemsets
+ * @param F      [out_param] the frequent itemsets, by size
+ * @param tree   the (conditional) FP-tree
+ * @param suffix the ranked items every itemset of the tree is extended with
+ * @param items  the item of every rank
+ * @param minsup the minimum support count
+ */
+static void mine_tree(SupportCountTable &sigma, std::vector<Itemsets> &F, const FPTree &tree,
+		std::vector<int> &suffix, const std::vector<Item> &items, const int minsup) {
+	std::vector<int> path, counts;
+	for (int r=(int) tree.head.size()-1; r>=0; r--) {
+		if (tree.support[r] < minsup)
+			continue;
+		suffix.push_back(r);
+		emit(sigma, F, suffix, items, tree.support[r]);
+
+		/* the support of every item within the conditional pattern base of r; its paths only hold ranks below r */
+		counts.assign(r, 0);
+		size_t base_sz = 0;
+		for (int n=tree.head[r]; n!=-1; n=tree.nodes[n].link)
+			for (int p=tree.nodes[n].parent; p>0; p=tree.nodes[p].parent) {
+				counts[ tree.nodes[p].item ] += tree.nodes[n].count;
+				base_sz++;
+			}
+
+		/* build the conditional tree from the frequent items of every prefix path, which have base_sz nodes at most */
+		FPTree cond(r, base_sz);
+		bool empty = true;
+		for (int n=tree.head[r]; n!=-1; n=tree.nodes[n].link) {
+			path.clear();
+			for (int p=tree.nodes[n].parent; p>0; p=tree.nodes[p].parent)
+				if (counts[ tree.nodes[p].item ] >= minsup)
+					path.push_back(tree.nodes[p].item);
+			if (!path.empty()) {
+				std::reverse(path.begin(), path.end());
+				cond.insert(path.data(), (int) path.size(), tree.nodes[n].count);
+				empty = false;
+			}
+		}
+		if (!empty)
+			mine_tree(sigma, F, cond, suffix, items, minsup);
+
+		suffix.pop_back();
+	}
+}
+
+/**
+ * Finds the frequent itemsets with the FP-Growth algorithm.
+ * The first pass over the transactions counts the items, the second inserts the frequent items of every transaction,
+ * ordered by decreasing support, into an FP-tree. The tree is then mined without generating candidates.
+ * Produces the same F and sigma as apriori.
+ * @param sigma  	[out_parameter] the support counts for all itemsets
+ * @param F      	[out_parameter] a vector of frequent itemsets where F[k] is the vector of all frequent k-itemsets
+ * @param T      	all transactions
+ * @param params 	the parameters used, i.e., minsup
+ * @param maxitem the largest item found in all transactions
+ */
+void fpgrowth(SupportCountTable &sigma, std::vector<Itemsets> &F, const DB &T, const Params &params, const Item maxitem) {
+	int minsup = params.minsup;
+
+	/* clean slate */
+	F.clear();
+	F.push_back(Itemsets());
+
+	/* first pass: count the items */
+	std::vector<int> counts(maxitem+1, 0);
+	for (const Transaction &t : T)
+		for (Item i : t)
+			counts[i]++;
+
+	/* rank the frequent items by decreasing support */
+	std::vector<Item> items;
+	for (Item item=0; item<=maxitem; item++)
+		if (counts[item] >= minsup)
+			items.push_back(item);
+	std::stable_sort(items.begin(), items.end(), [&](Item a, Item b) { return counts[a] > counts[b]; });
+	std::vector<int> rank(maxitem+1, -1);
+	for (int r=0; r<(int) items.size(); r++)
+		rank[ items[r] ] = r;
+
+	/* second pass: build the FP-tree, whose pool grows as needed since sharing prefixes is what keeps it small */
+	FPTree tree((int) items.size());
+	std::vector<int> path;
+	for (const Transaction &t : T) {
+		path.clear();
+		for (Item i : t)
+			if (rank[i] >= 0)
+				path.push_back(rank[i]);
+		std::sort(path.begin(), path.end());
+		tree.insert(path.data(), (int) path.size(), 1);
+	}
+
+	std::vector<int> suffix;
+	mine_tree(sigma, F, tree, suffix, items, minsup);
+
+	/* order the itemsets of every size lexicographically as apriori does */
+	for (Itemsets &Fk : F)
+		std::sort(Fk.begin(), Fk.end());
+}
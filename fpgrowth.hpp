@@ -0,0 +1,11 @@
+#ifndef _FPGROWTH_HPP
+#define _FPGROWTH_HPP
+
+#include "params.hpp"
+#include "types.hpp"
+
+#include <vector>
+
+void fpgrowth(SupportCountTable &sigma, std::vector<Itemsets> &F, const DB &T, const Params &params, const Item maxitem);
+
+#endif
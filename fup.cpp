@@ -0,0 +1,168 @@
+#include "fup.hpp"
+#include "apriori.hpp"
+#include "hash_tree.hpp"
+
+#include <algorithm>
+
+/**
+ * Updates the frequent itemsets of the first history transactions of T to all of T with the FUP algorithm of
+ * Cheung et al., "Maintenance of Discovered Association Rules in Large Databases".
+ * Level by level, the candidates are generated from the updated frequent itemsets and counted over the appended
+ * transactions only. A candidate that was frequent before gets its support from the previous result. Any other
+ * candidate was in less than old_minsup of the old transactions, so it is only counted over them, in one pass per
+ * level, if the appended transactions lift it to at least minsup-old_minsup+1.
+ * @param sigma      [out_param] the support counts of the frequent itemsets
+ * @param F          [out_param] the frequent itemsets where F[k] is the vector of all frequent (k+1)-itemsets
+ * @param T          all transactions, the old ones first. The appended transactions are moved out of T and pruned.
+ * @param history    the number of old transactions
+ * @param old_F      all itemsets which are frequent in the old transactions at old_minsup, in lexicographical order
+ * @param old_S      old_S[k][x] is the support count of old_F[k][x] in the old transactions
+ * @param old_minsup the minsup the old frequent itemsets were mined with, at most params.minsup
+ * @param params     the parameters used, i.e., minsup, hfrange, maxleafsize, threads
+ * @param maxitem    the largest item found in all transactions
+ * @return           how much of the old transactions had to be scanned again
+ */
+FupStats fup(SupportCountTable &sigma, std::vector<Itemsets> &F, DB &T, const size_t history, const std::vector<Itemsets> &old_F,
+	const std::vector< std::vector<int> > &old_S, const int old_minsup, const Params &params, const Item maxitem) {
+	int minsup = params.minsup, lift = minsup-old_minsup+1;
+	SupportIndex old(old_F, old_S);
+	DB delta = T.split_off(history);
+	FupStats st;
+	st.delta = delta.size();
+	st.history_scans = 0;
+	st.history_candidates = 0;
+
+	/* clean slate */
+	F.assign(1, Itemsets());
+	std::vector< std::vector<int> > S(1);
+
+	/* the 1-itemsets, counting the items which were infrequent before over the old transactions if lifted enough */
+	std::vector<int> counts(maxitem+1, 0);
+	std::vector<char> rescan(maxitem+1, 0);
+	for (const Transaction &t : delta)
+		for (Item i : t)
+			counts[i]++;
+	for (Item i=0; i<=maxitem; i++) {
+		int sup = old(&i, 1);
+		if (sup >= 0)
+			counts[i] += sup;
+		else if (counts[i] >= lift) {
+			rescan[i] = 1;
+			st.history_candidates++;
+		}
+	}
+	if (st.history_candidates) {
+		st.history_scans++;
+		for (const Transaction &t : T)
+			for (Item i : t)
+				counts[i] += rescan[i];
+	}
+	for (Item i=0; i<=maxitem; i++)
+		if (counts[i] >= minsup && (rescan[i] || old(&i, 1) >= 0)) {
+			F[0].push_back( Itemset({i}) );
+			S[0].push_back(counts[i]);
+		}
+
+	/* the 2-itemsets, counting all pairs of frequent items in a triangle instead of generating candidates */
+	int m = (int) F[0].size();
+	if (m > 1) {
+		std::vector<int> code(maxitem+1, -1);
+		for (int id=0; id<m; id++)
+			code[ F[0][id][0] ] = id;
+		PairCounts tri(m);
+		tri.count(delta, code, params.threads);
+		std::vector<int> old_tri;
+
+		/* old_tri holds the old support counts, -1 for the pairs which weren't lifted enough and -2 for those to rescan */
+		old_tri.assign(tri.cells(), -1);
+		uint64_t to_rescan = 0;
+		for (int a=0; a<m-1; a++)
+			for (int b=a+1; b<m; b++) {
+				size_t cell = tri.cell(a, b);
+				Item pair[2] = { F[0][a][0], F[0][b][0] };
+				int sup = old(pair, 2);
+				if (sup >= 0)
+					old_tri[cell] = sup;
+				else if (tri[cell] >= lift) {
+					old_tri[cell] = -2;
+					to_rescan++;
+				}
+			}
+		if (to_rescan) {
+			st.history_scans++;
+			st.history_candidates += to_rescan;
+			PairCounts hist(m);
+			hist.count(T, code, params.threads);
+			for (size_t cell=0; cell<tri.cells(); cell++)
+				if (old_tri[cell] == -2)
+					old_tri[cell] = hist[cell];
+		}
+
+		F.push_back(Itemsets());
+		S.push_back(std::vector<int>());
+		for (int a=0; a<m-1; a++)
+			for (int b=a+1; b<m; b++) {
+				size_t cell = tri.cell(a, b);
+				if (old_tri[cell] >= 0 && old_tri[cell]+tri[cell] >= minsup) {
+					F.back().push_back( Itemset({F[0][a][0], F[0][b][0]}) );
+					S.back().push_back(old_tri[cell]+tri[cell]);
+				}
+			}
+		if (F.back().empty()) {
+			F.pop_back();
+			S.pop_back();
+		}
+	}
+
+	/* the larger itemsets, counting the candidates over the appended transactions and the lifted ones over the old */
+	while (F.size() > 1 && F.back().size() > 1) {
+		size_t k = F.back()[0].size()+1;
+		Itemsets C;
+		apriori_gen(C, F.back(), params.threads);
+		if (C.empty())
+			break;
+		HashTree hash_tree(C, params.hfrange, params.maxleafsize);
+		count_support(counts, delta, hash_tree, params.threads);
+
+		Itemsets R;
+		std::vector<int> lifted; // the id in C of every candidate in R
+		for (int id=0, c_sz=(int) C.size(); id<c_sz; id++) {
+			int sup = old(C[id].data(), k);
+			if (sup >= 0)
+				counts[id] += sup;
+			else if (counts[id] >= lift) {
+				R.push_back(C[id]);
+				lifted.push_back(id);
+			}
+			else
+				counts[id] = -1;
+		}
+		if (!R.empty()) {
+			st.history_scans++;
+			st.history_candidates += R.size();
+			std::vector<int> hist;
+			HashTree rescan_tree(R, params.hfrange, params.maxleafsize);
+			count_support(hist, T, rescan_tree, params.threads, false);
+			for (size_t x=0; x<R.size(); x++)
+				counts[ lifted[x] ] += hist[x];
+		}
+
+		F.push_back(Itemsets());
+		S.push_back(std::vector<int>());
+		for (int id=0, c_sz=(int) C.size(); id<c_sz; id++)
+			if (counts[id] >= minsup) {
+				F.back().push_back( std::move(C[id]) );
+				S.back().push_back(counts[id]);
+			}
+		if (F.back().empty()) {
+			F.pop_back();
+			S.pop_back();
+			break;
+		}
+	}
+
+	for (size_t k=0; k<F.size(); k++)
+		for (size_t x=0; x<F[k].size(); x++)
+			sigma[ F[k][x] ] = S[k][x];
+	return st;
+}
@@ -0,0 +1,22 @@
+#ifndef _FUP_HPP
+#define _FUP_HPP
+
+#include "params.hpp"
+#include "types.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * How much of the old transactions an incremental update had to look at
+ */
+struct FupStats {
+	uint64_t delta;              // transactions appended since the previous result
+	int history_scans;           // passes over the old transactions
+	uint64_t history_candidates; // candidates counted over the old transactions
+};
+
+FupStats fup(SupportCountTable &sigma, std::vector<Itemsets> &F, DB &T, const size_t history, const std::vector<Itemsets> &old_F,
+	const std::vector< std::vector<int> > &old_S, const int old_minsup, const Params &params, const Item maxitem);
+
+#endif
@@ -5,176 +5,258 @@
 #include <iostream>
 #include <cstdlib>
 
-std::vector<int> indeces;
+/* the auto mode's leaf size is AUTO_LEAF_PER_ITEM*k candidates, but at least AUTO_MIN_LEAF */
+#define AUTO_LEAF_PER_ITEM 8
+#define AUTO_MIN_LEAF 16
+/* the auto mode's branching factor is the number of distinct items, but at most what keeps the node tables within
+ * AUTO_TABLE_BUDGET entries, or within AUTO_BRANCH_PER_LEAF entries per candidate if that is more */
+#define AUTO_TABLE_BUDGET (1<<20)
+#define AUTO_BRANCH_PER_LEAF 4
 
 /* Empty constructor for declarations purposes */
-HashTree::HashTree() {}
-
-/**
- * @constructor (private)
- * used to set values from intermediate node to its children. 
- * The parameter meanings can be infered from their assignments in the below constructor.
- */
-HashTree::HashTree(const int b, const int d, const int n, const int max, SupportCountTable *t) {
-	isLeaf = true;
-	bfactor = b;
-	depth = d;
-	num_items = n;
-	bz_max = max;
-	sigma = t;
-
-	bucket.reserve((size_t) bz_max);
-	node.reserve((size_t) bfactor);
-}
-
+HashTree::HashTree() : bfactor(1), num_items(0), bz_max(0), root(0), max_depth(0) {}
 
 /**
  * @constructor
  * Generate the hashtree with the given itemsets.
+ * Each candidate is identified by its index in C, which is also its slot in HashTreeCounter::counts.
  * If leaf node, the itemsets are ordered lexicophically between itemsets as well as within itemsets.
- * If intermediate node, a has function i%hfrange is used to determine which branch to tranverse. 
+ * If intermediate node, the item is hashed to a branch as set up by configure. 
  * @param C 					The input candidate itemsets. Assumes lexicographical ordering of the candate itemsets as well as items within itemsets.
- * @param table 			The support table for which to generate the support count
- * @param hfrange 		The branching factor
- * @param maxleafsize The maximum bucket size
+ * @param hfrange 		The branching factor, or 0 to choose it from the candidates, see configure
+ * @param maxleafsize The maximum bucket size, or 0 to choose it from the candidates
  */
-HashTree::HashTree(const Itemsets &C, SupportCountTable *table, const int hfrange, const int maxleafsize) {
-	isLeaf = true;
-	bfactor = hfrange;
-	depth = 0;
+HashTree::HashTree(const Itemsets &C, const int hfrange, const int maxleafsize) {
 	num_items = C.back().size();
-	sigma = table;
-	bz_max = maxleafsize;
+	max_depth = 0;
 
-	bucket.reserve((size_t) bz_max);
-	node.reserve((size_t) bfactor);
-	for (const Itemset &s : C) {
-		add_itemset(&s);
-	}
+	ids.reserve(C.size());
+	items.reserve(C.size()*num_items);
+	leaf_off.push_back(0);
+
+	configure(C, hfrange, maxleafsize);
+	std::vector<int> bucket(C.size());
+	for (int id=0, c_sz=(int) C.size(); id<c_sz; id++)
+		bucket[id] = id;
+	root = build(C, bucket, 0);
 	// print_leaves();
-	indeces.clear();
-	indeces.reserve(depth);
 }
 
 /**
- * Adds the provided itemset to the hash tree
- * @param set         The input itemset to add. Assumes lexicographical ordering.
+ * Sets the branching factor and leaf size and assigns the items of the candidates to the branches.
+ * In auto mode the leaf size grows with k, since every leaf candidate is compared item by item. Every distinct item
+ * of the candidates gets its own branch as long as the node tables stay small, since a wider node sends a transaction
+ * to fewer leaves and makes the tree shallower. About |C|/maxleafsize interior nodes are expected, so the branching
+ * factor is at most AUTO_TABLE_BUDGET*maxleafsize/|C|, letting the tree of a few candidates hash them straight
+ * into leaves, but at least AUTO_BRANCH_PER_LEAF times the leaf size, which keeps the tables of many candidates
+ * within a small multiple of the candidates' size. On Quest data, 1.5M 3-candidates got 96 branches, where a branch
+ * per item took 2.7 times the memory, and 4k to 26k candidates a branch per item, which counted up to 20% faster.
+ * The leaf size only depends on k: halving it, or deriving the branching factor from a target depth, was slower
+ * at every |C| measured.
+ * The items are assigned heaviest first, each to the branch with the fewest candidate occurrences so far. Unlike
+ * item%bfactor this keeps the branches balanced however the items are numbered and distributed, and it lets the
+ * traversal skip the items of a transaction which are in no candidate.
+ * @param C 					The candidate itemsets
+ * @param hfrange 		The branching factor, or 0 for auto
+ * @param maxleafsize The maximum bucket size, or 0 for auto
+ */
+void HashTree::configure(const Itemsets &C, const int hfrange, const int maxleafsize) {
+	Item max_item = 0;
+	for (const Itemset &c : C)
+		max_item = std::max(max_item, c.back());
+	std::vector<long long> occurrences(max_item+1, 0);
+	for (const Itemset &c : C)
+		for (Item i : c)
+			occurrences[i]++;
+
+	std::vector<Item> order;
+	for (Item i=0; i<=max_item; i++)
+		if (occurrences[i])
+			order.push_back(i);
+	std::stable_sort(order.begin(), order.end(), [&](Item a, Item b) { return occurrences[a] > occurrences[b]; });
+
+	bz_max = maxleafsize > 0? maxleafsize: std::max(AUTO_MIN_LEAF, AUTO_LEAF_PER_ITEM*num_items);
+	long long budget = (long long) AUTO_TABLE_BUDGET*bz_max/std::max((size_t) 1, C.size());
+	bfactor = hfrange > 0? hfrange: std::max(2, (int) std::min((long long) order.size(), std::max((long long) AUTO_BRANCH_PER_LEAF*bz_max, budget)));
+
+	std::vector<long long> load(bfactor, 0);
+	branch_of.assign(max_item+1, -1);
+	for (Item i : order) {
+		int b = (int) (std::min_element(load.begin(), load.end())-load.begin());
+		branch_of[i] = b;
+		load[b] += occurrences[i];
+	}
+}
+
+/**
+ * @return The branching factor in use
+ */
+int HashTree::branching() const {
+	return bfactor;
+}
+
+/**
+ * @return The maximum leaf size in use
+ */
+int HashTree::leaf_size() const {
+	return bz_max;
+}
+
+/**
+ * Lays out the subtree holding the given candidates.
+ * A node whose bucket is larger than the max is decomposed into bfactor branches, unless it is already at depth k.
+ * The candidates of a leaf keep their order in C.
+ * @param C 		 The candidate itemsets
+ * @param bucket The ids of the candidates in this subtree. Consumed.
+ * @param depth  The depth of the subtree root
+ * @return 			 The reference to the subtree root, see HashTree
  */
-void HashTree::add_itemset(const Itemset *set) {
-	if (isLeaf) {
-		bucket.push_back(set);
-
-		// if bucket is larger than max then decompose into multiple branches
-		if ((int) bucket.size() > bz_max) {
-			if (depth == num_items) // can't decompose with this bfactor so do nothing
-				return;
-			
-			isLeaf = false; // now an intermediate node
-			// initialize the children
-			for (int i=0; i!=bfactor; i++)
-				node.push_back( HashTree(bfactor, depth+1, num_items, bz_max, sigma) );
-
-			// add the itemsets in the bucket to the corresponding children
-			for (const Itemset *s : bucket) 
-				node[ (*s)[depth]%bfactor ].add_itemset(s);
-			
-			// clear the old leaf node memory
-			bucket.clear();
+int HashTree::build(const Itemsets &C, std::vector<int> &bucket, int depth) {
+	max_depth = std::max(max_depth, depth);
+	if ((int) bucket.size() <= bz_max || depth == num_items) {
+		for (int id : bucket) {
+			ids.push_back(id);
+			items.insert(items.end(), C[id].begin(), C[id].end());
 		}
+		leaf_off.push_back((int) ids.size());
+		return ~((int) leaf_off.size()-2);
+	}
+
+	/* hash the bucket into the branches */
+	std::vector< std::vector<int> > branch(bfactor);
+	for (int id : bucket)
+		branch[ branch_of[ C[id][depth] ] ].push_back(id);
+	std::vector<int>().swap(bucket);
 
+	int offset = (int) nodes.size();
+	nodes.resize(offset+bfactor);
+	for (int i=0; i!=bfactor; i++) {
+		int ref = build(C, branch[i], depth+1);
+		nodes[offset+i] = ref;
 	}
-	else // intermediate node so hash away
-		node[ (*set)[depth]%bfactor ].add_itemset(set);
+	return offset;
 }
 
 /*
  * Updates the support count of the input transaction
- * @param t 	The input transaction for which to update the support count
- * @return 		True if transaction updated support count. False otherwise. 
+ * @param t 			The input transaction for which to update the support count
+ * @param counter The calling worker's traversal state and support counts
+ * @return 				True if transaction updated support count. False otherwise. 
  */
-bool HashTree::operator()(const Transaction &t) {
-	/* reset visited flag */
+bool HashTree::operator()(const Transaction &t, HashTreeCounter &counter) const {
 	if ((int) t.size() < num_items)
 		return false;
-	else
-		return traverse(t, 0);
+	counter.indeces.clear();
+	return traverse(root, t, 0, counter);
+}
+
+/**
+ * @return The number of candidates in the tree, i.e., the size of the count buffer a counter needs
+ */
+int HashTree::size() const {
+	return (int) ids.size();
+}
+
+/**
+ * @return The number of interior nodes
+ */
+int HashTree::num_nodes() const {
+	return (int) nodes.size()/bfactor;
+}
+
+/**
+ * @return The number of leaves
+ */
+int HashTree::num_leaves() const {
+	return (int) leaf_off.size()-1;
+}
+
+/**
+ * @return The depth of the deepest leaf, the root being at depth 0
+ */
+int HashTree::depth() const {
+	return max_depth;
 }
 
 /**
  * Traverse the hashtree with the given transaction so as to visit every candidate subset of t atleast once
+ * @param ref 			the node to traverse, see HashTree. Its depth is the number of hashed indeces so far.
  * @param t 				the transaction
- * @param indeces 	the index at which we hash the transaction for the current deoth
+ * @param index 		the index at which we hash the transaction for the current depth
+ * @param counter 	the worker's hashed indeces so far and the support counts to update
  */
-bool HashTree::traverse(const Transaction &t, int index) {
+bool HashTree::traverse(int ref, const Transaction &t, int index, HashTreeCounter &counter) const {
 	/* if already visited bucket then don't traverse again */
 	bool has_updated = false;
+	std::vector<int> &indeces = counter.indeces;
+	std::vector<int> &counts = counter.counts;
+	int depth = (int) indeces.size();
+
+	if (ref < 0) { // leaf node
+		const int *id = ids.data()+leaf_off[~ref], *id_end = ids.data()+leaf_off[~ref+1];
+		const Item *s = items.data()+(size_t)leaf_off[~ref]*num_items;
 
-	if (isLeaf) {
 		/* special efficient case for k=2 */
 		if (num_items==2) {
 			if (depth == 2) {
 				int t1=t[ indeces[0] ], t2=t[ indeces[1] ];
-				for (const Itemset *set : bucket) {
-					const Itemset &s = *set;
+				for (; id!=id_end; id++, s+=2)
 					if (t1==s[0] && t2==s[1]) {
-						(*sigma)[s] += 1;
+						counts[*id]++;
 						has_updated = true;
 					}
-					// else if ( (t1==s[0]&&t2<s[1]) || t1<s[0] )
-					// 	return has_updated;
-				}
 			}
 			else if (depth == 1) {
 				int i, i1, t_sz = (int) t.size(), t1 = t[ i1=indeces[0] ];
-				for (const Itemset *set : bucket) {
-					const Itemset &s = *set;
+				for (; id!=id_end; id++, s+=2)
 					if (t1==s[0]) {
 						for (i=i1+1; i<t_sz && t[i]!=s[1]; i++);
 						if (i<t_sz) {
-							(*sigma)[s] += 1;
+							counts[*id]++;
 							has_updated = true;
 						}
 					}
-					// else if (t1<s[0])
-					// 	return has_updated;
-				}
 			}
 			else 
-				for (const Itemset *s : bucket)
-					if ( std::includes(t.begin(), t.end(), s->begin(), s->end()) ) 
+				for (; id!=id_end; id++, s+=2)
+					if ( std::includes(t.begin(), t.end(), s, s+2) ) 
 					{
-						(*sigma)[*s] += 1;
+						counts[*id]++;
 						has_updated = true;
 					}
 		}
 		else
-			for (const Itemset *s : bucket) {
+			for (; id!=id_end; id++, s+=num_items) {
 				bool match_prefix = true;
 				int j=0, i=-1;
 				for (int ii : indeces)
-					if (t[i=ii] != (*s)[j++]) {
+					if (t[i=ii] != s[j++]) {
 						match_prefix = false;
 						break;
 					}
 				if (match_prefix) {
-					if ( j==num_items || std::includes(t.begin()+index, t.end(), s->begin()+j, s->end()) ) 
+					if ( j==num_items || std::includes(t.begin()+index, t.end(), s+j, s+num_items) ) 
 					{
-						(*sigma)[*s] += 1;
+						counts[*id]++;
 						has_updated = true;
 					}
 					
 				}
-				else if (t[i]<(*s)[0])
+				else if (t[i]<s[0])
 					return has_updated;
 			}
 	}
 	else { // intermediate node
 		// hash the transaction over each branch
-		int t_sz = (int) t.size(), cap = t_sz-num_items+depth+1;
+		const int *child = nodes.data()+ref;
+		int t_sz = (int) t.size(), cap = t_sz-num_items+depth+1, b_sz = (int) branch_of.size();
 		cap = cap>t_sz? t_sz: cap;
 		for (int j=index; j<cap; j++) {
+			int b = t[j]<b_sz? branch_of[ t[j] ]: -1;
+			if (b < 0) // no candidate has this item
+				continue;
 			indeces.push_back(j);
-			has_updated = node[ t[j]%bfactor ].traverse(t, j+1) || has_updated; // avoid short-circuit
+			has_updated = traverse(child[b], t, j+1, counter) || has_updated; // avoid short-circuit
 			indeces.pop_back();
 		}
 	}
@@ -186,13 +268,10 @@ bool HashTree::traverse(const Transaction &t, int index) {
 /**
  * Print the leaves of the hash tree
  */
-void HashTree::print_leaves() {
-	if (isLeaf) {
-		for (const Itemset *s : bucket)
-			print_itemset(*s);
+void HashTree::print_leaves() const {
+	for (int l=0; l+1<(int) leaf_off.size(); l++) {
+		for (int p=leaf_off[l]; p!=leaf_off[l+1]; p++)
+			print_itemset( Itemset(items.begin()+(size_t)p*num_items, items.begin()+(size_t)(p+1)*num_items) );
 		std::cout << std::endl<<std::endl;
 	}
-	else
-		for (HashTree &t : node)
-			t.print_leaves();
 }
\ No newline at end of file
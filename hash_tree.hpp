@@ -5,25 +5,48 @@
 
 #include "types.hpp"
 
+/**
+ * Per-worker traversal state and support counts.
+ * Each counting thread owns one so that HashTree traversal shares no mutable state.
+ * counts[id] is the support count of the candidate C[id] the tree was built from.
+ */
+struct HashTreeCounter {
+	std::vector<int> counts;
+	std::vector<int> indeces;
+};
+
+/**
+ * Hash tree over the candidate k-itemsets, stored flat.
+ * An interior node is a table of bfactor child references packed in nodes.
+ * A child reference r >= 0 is the offset of an interior node in nodes, r < 0 is the leaf ~r.
+ * Leaf l holds the candidate slots [leaf_off[l], leaf_off[l+1]). Slot p is the candidate with id ids[p]
+ * whose k items are stored inline at items[p*k, p*k+k), so a bucket scan streams through memory.
+ * An item is hashed to the branch branch_of[item]. The items are spread over the branches so that every branch
+ * gets about the same number of candidate occurrences, and items in no candidate map to -1 and are never followed.
+ */
 class HashTree {
-	typedef std::vector<const Itemset*> LeafNode;
-	typedef std::vector<HashTree> InterNode;
+	int bfactor, num_items, bz_max, root, max_depth;
 
-	bool isLeaf;
-	int bfactor, depth, num_items, bz_max;
-	SupportCountTable *sigma;
+	std::vector<int> branch_of;
+	std::vector<int> nodes;
+	std::vector<int> leaf_off;
+	std::vector<int> ids;
+	std::vector<Item> items;
 
-	InterNode node;
-	LeafNode bucket;
-	
-	void add_itemset(const Itemset *set);
-	bool traverse(const Transaction &t, int index);
-	HashTree(const int b, const int d, const int n, const int max, SupportCountTable *t);
-	void print_leaves();
+	void configure(const Itemsets &C, const int hfrange, const int maxleafsize);
+	int build(const Itemsets &C, std::vector<int> &bucket, int depth);
+	bool traverse(int ref, const Transaction &t, int index, HashTreeCounter &counter) const;
+	void print_leaves() const;
 public:
 	HashTree();
-	HashTree(const Itemsets &C, SupportCountTable *table, const int hfrange, const int maxleafsize);
-	bool operator()(const Transaction &t);
+	HashTree(const Itemsets &C, const int hfrange, const int maxleafsize);
+	bool operator()(const Transaction &t, HashTreeCounter &counter) const;
+	int size() const;
+	int num_nodes() const;
+	int num_leaves() const;
+	int depth() const;
+	int branching() const;
+	int leaf_size() const;
 };
 
-#endif
\ No newline at end of file
+#endif
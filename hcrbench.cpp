@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "apriori.hpp"
+#include "params.hpp"
+#include "stats.hpp"
+#include "synthetic.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+using std::chrono::duration;
+using std::chrono::high_resolution_clock;
+
+/**
+ * A dataset to benchmark and the thresholds it is mined with.
+ */
+struct BenchDataset {
+	std::string name, fn;
+	int minsup;
+	float minconf;
+};
+
+/**
+ * The timings of one stage over all measured runs.
+ */
+struct StageTimes {
+	std::string stage;
+	std::vector<double> seconds;
+};
+
+/**
+ * Runs stage warmup+runs times and records the measured runs.
+ * @param times the timings to append to
+ * @param stage the work to time. setup, if any, is run untimed before every run.
+ */
+static void measure(StageTimes &times, const int warmup, const int runs, const std::function<void()> &stage, const std::function<void()> &setup = std::function<void()>()) {
+	for (int r=0; r<warmup+runs; r++) {
+		if (setup)
+			setup();
+		high_resolution_clock::time_point t0 = high_resolution_clock::now();
+		stage();
+		high_resolution_clock::time_point t1 = high_resolution_clock::now();
+		if (r >= warmup)
+			times.seconds.push_back( duration<double>(t1-t0).count() );
+	}
+}
+
+static double median(std::vector<double> v) {
+	std::sort(v.begin(), v.end());
+	size_t n = v.size();
+	return n%2? v[n/2]: (v[n/2-1]+v[n/2])/2;
+}
+
+static double mean(const std::vector<double> &v) {
+	double sum = 0;
+	for (double x : v)
+		sum += x;
+	return sum/v.size();
+}
+
+static double variance(const std::vector<double> &v) {
+	double m = mean(v), sum = 0;
+	for (double x : v)
+		sum += (x-m)*(x-m);
+	return v.size() > 1? sum/(v.size()-1): 0;
+}
+
+/**
+ * Times every stage of the pipeline on one dataset.
+ * @return the timings of all stages
+ */
+static std::vector<StageTimes> bench_dataset(const BenchDataset &ds, const Params &params, const int warmup, const int runs, const std::string &scratch, size_t stats[3]) {
+	std::vector<StageTimes> result;
+	auto stage = [&](const char *name) -> StageTimes& {
+		result.push_back( StageTimes{name, std::vector<double>()} );
+		return result.back();
+	};
+
+	DB T;
+	int max_item = 0;
+	measure(stage("read_db"), warmup, runs, [&]() { max_item = read_db(ds.fn, T, params.threads); }, [&]() { T.clear(); });
+
+	std::vector<Itemsets> F;
+	SupportCountTable sigma;
+	DB work;
+	MiningStats level_stats;
+	std::vector<MiningStats> run_stats;
+	measure(stage("apriori"), warmup, runs, [&]() {
+		apriori(sigma, F, work, params, max_item, &level_stats);
+		run_stats.push_back(level_stats);
+	}, [&]() { work = T; F.clear(); sigma.clear(); });
+
+	/* the per stage breakdown of the measured apriori() runs, as recorded per level */
+	const char *names[6] = {"count_items", "count_pairs", "recode_trim_prune", "apriori_gen", "hash_tree_build", "count_support"};
+	std::vector<double> staged[6];
+	for (size_t r=warmup; r<run_stats.size(); r++) {
+		double t[6] = {0, 0, 0, 0, 0, 0};
+		for (const LevelStats &l : run_stats[r].levels) {
+			t[ l.k == 1? 0: l.k == 2? 1: 5 ] += l.count_time;
+			t[2] += l.prune_time;
+			t[3] += l.gen_time;
+			t[4] += l.build_time;
+		}
+		for (int s=0; s<6; s++)
+			staged[s].push_back(t[s]);
+	}
+	for (int s=0; s<6; s++)
+		stage(names[s]).seconds = staged[s];
+
+	Rules rules;
+	measure(stage("get_rules"), warmup, runs, [&]() { get_rules(rules, sigma, F, ds.minconf, params.threads); });
+
+	std::string out = scratch+"/hcrbench.out";
+	int how_many = (int) T.size();
+	measure(stage("write_frequent_itemsets"), warmup, runs, [&]() { write_frequent_itemsets(out, F, sigma, how_many); });
+	measure(stage("write_rules"), warmup, runs, [&]() { write_rules(out, rules, how_many); });
+	std::remove(out.c_str());
+
+	stats[0] = T.size();
+	stats[1] = 0;
+	for (const Itemsets &Fk : F)
+		stats[1] += Fk.size();
+	stats[2] = rules.size();
+	return result;
+}
+
+/**
+ * Benchmarks the stages of the mining pipeline: reading, the whole of apriori(), its building blocks as timed within those runs,
+ * rule generation and writing the results. The synthetic dataset comes from the Quest style generator with its defaults. Every stage runs warmup times untimed and then runs times,
+ * and the median, mean, variance, min and max of the runs are reported, also as JSON for comparing builds.
+ */
+int main(int argc, char *argv[]) {
+	int warmup = 1, runs = 5;
+	std::string json = "bench.json", scratch = "/tmp";
+	int synthetic = 200000;
+	Params params;
+	std::vector<BenchDataset> datasets;
+
+	for (int i=1; i<argc; i++) {
+		if (!std::strcmp(argv[i], "--warmup") && i+1<argc)
+			warmup = std::atoi(argv[++i]);
+		else if (!std::strcmp(argv[i], "--runs") && i+1<argc)
+			runs = std::max(1, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--json") && i+1<argc)
+			json = argv[++i];
+		else if (!std::strcmp(argv[i], "--scratch") && i+1<argc)
+			scratch = argv[++i];
+		else if (!std::strcmp(argv[i], "--threads") && i+1<argc)
+			params.threads = std::max(1, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--synthetic") && i+1<argc)
+			synthetic = std::atoi(argv[++i]);
+		else if (!std::strcmp(argv[i], "--dataset") && i+3<argc) {
+			BenchDataset ds{argv[i+1], argv[i+1], std::atoi(argv[i+2]), (float) std::atof(argv[i+3])};
+			datasets.push_back(ds);
+			i += 3;
+		}
+		else {
+			printf("usage: ./hcrbench [--warmup N] [--runs N] [--json FILE] [--scratch DIR] [--threads N] [--synthetic TRANSACTIONS] [--dataset FILE MINSUP MINCONF]...\n");
+			exit(1);
+		}
+	}
+
+	if (datasets.empty()) {
+		datasets.push_back( BenchDataset{"data/small", "data/small", 30, 0.5} );
+		datasets.push_back( BenchDataset{"data/inter", "data/inter", 200, 0.5} );
+		if (synthetic > 0) {
+			std::string fn = scratch+"/hcrbench.synthetic";
+			QuestParams quest;
+			quest.transactions = synthetic;
+			write_quest(fn, quest, false);
+			datasets.push_back( BenchDataset{"quest-"+std::to_string(synthetic), fn, synthetic/200, 0.5} );
+		}
+	}
+
+	FILE *out = fopen(json.c_str(), "w");
+	if (!out) {
+		printf("unable to write \'%s\'\n", json.c_str());
+		exit(1);
+	}
+	fprintf(out, "{\n  \"warmup\": %i,\n  \"runs\": %i,\n  \"threads\": %i,\n  \"datasets\": [", warmup, runs, params.threads);
+
+	printf("%-24s %-24s %10s %10s %10s %10s\n", "dataset", "stage", "median_s", "stddev_s", "min_s", "max_s");
+	for (size_t d=0; d<datasets.size(); d++) {
+		const BenchDataset &ds = datasets[d];
+		params.minsup = ds.minsup;
+		params.minconf = ds.minconf;
+		size_t stats[3];
+		std::vector<StageTimes> result = bench_dataset(ds, params, warmup, runs, scratch, stats);
+
+		fprintf(out, "%s\n    {\"name\": \"%s\", \"minsup\": %i, \"minconf\": %g, \"transactions\": %zu, \"frequent_itemsets\": %zu, \"rules\": %zu, \"stages\": [",
+			d? ",": "", ds.name.c_str(), ds.minsup, ds.minconf, stats[0], stats[1], stats[2]);
+		for (size_t s=0; s<result.size(); s++) {
+			const std::vector<double> &v = result[s].seconds;
+			double med = median(v), var = variance(v);
+			double lo = *std::min_element(v.begin(), v.end()), hi = *std::max_element(v.begin(), v.end());
+			printf("%-24s %-24s %10.4f %10.4f %10.4f %10.4f\n", ds.name.c_str(), result[s].stage.c_str(), med, std::sqrt(var), lo, hi);
+			fprintf(out, "%s\n      {\"stage\": \"%s\", \"median\": %.6g, \"mean\": %.6g, \"variance\": %.6g, \"min\": %.6g, \"max\": %.6g, \"runs\": [",
+				s? ",": "", result[s].stage.c_str(), med, mean(v), var, lo, hi);
+			for (size_t r=0; r<v.size(); r++)
+				fprintf(out, "%s%.6g", r? ", ": "", v[r]);
+			fprintf(out, "]}");
+		}
+		fprintf(out, "\n    ]}");
+	}
+	fprintf(out, "\n  ]\n}\n");
+	fclose(out);
+
+	if (datasets.back().fn == scratch+"/hcrbench.synthetic")
+		std::remove(datasets.back().fn.c_str());
+	return 0;
+}
@@ -0,0 +1,24 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "binary_db.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+/**
+ * Converts a text transaction file of <tid> <item> lines into the binary transaction format read by hcrminer.
+ */
+int main(int argc, char *argv[]) {
+	if (argc < 3 || argc > 4 || (argc == 4 && std::strcmp(argv[3], "--no-freq"))) {
+		printf("usage: ./hcrconvert <inputfile> <outputfile> [--no-freq]\n");
+		exit(1);
+	}
+
+	DB T;
+	read_db(argv[1], T);
+	write_binary_db(argv[2], T, argc == 3);
+	printf("# of transactions: %zu\n", T.size());
+	return 0;
+}
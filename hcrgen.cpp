@@ -0,0 +1,61 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "synthetic.hpp"
+
+using std::chrono::duration;
+using std::chrono::high_resolution_clock;
+
+/**
+ * Generates a synthetic transaction file in the style of the IBM Quest generator.
+ * The same parameters and seed always give the same file.
+ */
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("usage: ./hcrgen <outputfile> [--transactions N] [--avg-len T] [--items N] [--patterns L] [--pattern-len I] [--correlation C] [--corruption R] [--seed S] [--binary]\n");
+		exit(1);
+	}
+
+	QuestParams params;
+	bool binary = false;
+	for (int i=2; i<argc; i++) {
+		if (!std::strcmp(argv[i], "--transactions") && i+1<argc)
+			params.transactions = std::strtoull(argv[++i], NULL, 10);
+		else if (!std::strcmp(argv[i], "--avg-len") && i+1<argc)
+			params.avg_len = std::atof(argv[++i]);
+		else if (!std::strcmp(argv[i], "--items") && i+1<argc)
+			params.num_items = std::atoi(argv[++i]);
+		else if (!std::strcmp(argv[i], "--patterns") && i+1<argc)
+			params.num_patterns = std::atoi(argv[++i]);
+		else if (!std::strcmp(argv[i], "--pattern-len") && i+1<argc)
+			params.avg_pattern_len = std::atof(argv[++i]);
+		else if (!std::strcmp(argv[i], "--correlation") && i+1<argc)
+			params.correlation = std::atof(argv[++i]);
+		else if (!std::strcmp(argv[i], "--corruption") && i+1<argc)
+			params.corruption = std::atof(argv[++i]);
+		else if (!std::strcmp(argv[i], "--seed") && i+1<argc)
+			params.seed = std::strtoull(argv[++i], NULL, 10);
+		else if (!std::strcmp(argv[i], "--binary"))
+			binary = true;
+		else {
+			printf("unknown option \'%s\'\n", argv[i]);
+			exit(1);
+		}
+	}
+	if (params.num_items < 1 || params.avg_len <= 0 || params.avg_pattern_len <= 0) {
+		printf("--items, --avg-len and --pattern-len must be positive\n");
+		exit(1);
+	}
+
+	high_resolution_clock::time_point t1 = high_resolution_clock::now();
+	uint64_t occurrences = write_quest(argv[1], params, binary);
+	double secs = duration<double>(high_resolution_clock::now()-t1).count();
+
+	printf("# of transactions: %llu\n", (unsigned long long) params.transactions);
+	printf("# of item occurrences: %llu\n", (unsigned long long) occurrences);
+	printf("time-generate: %.3f\n", secs);
+	return 0;
+}
@@ -1,28 +1,47 @@
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <fstream>
 #include <string>
 #include <sstream>
 #include <iostream>
+#include <memory>
 
 #include "apriori.hpp"
+#include "eclat.hpp"
+#include "itemset_index.hpp"
+#include "fpgrowth.hpp"
+#include "fup.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 #include "params.hpp"
+#include "partition.hpp"
+#include "rule_server.hpp"
+#include "sample.hpp"
+#include "stats.hpp"
 
+using std::chrono::duration;
 using std::chrono::milliseconds;
 using std::chrono::duration_cast;
 using std::chrono::high_resolution_clock;
 
 high_resolution_clock::time_point t1, t2, t3;
 
+void mine(const std::string &engine, SupportCountTable &sigma, std::vector<Itemsets> &F, DB &T, const Params &params, const int max_item, MiningStats *stats = NULL);
+void sample(SupportCountTable &sigma, std::vector<Itemsets> &F, const DB &T, const Params &params, const int max_item);
+void update(SupportCountTable &sigma, std::vector<Itemsets> &F, DB &T, const Params &params, const int max_item);
+bool cross_check(const Params &params, const SupportCountTable &sigma, const std::vector<Itemsets> &F, DB &T, const int max_item);
+int sweep(const Params &params);
+int query_index(const Params &params);
+
 #ifdef _DEBUG // used by me in comparing my frequent itemsets with support count with those of professor's code
 	void debug_write_frequent_itemsets(const std::string& fn, const std::vector<Itemsets>& F, const SupportCountTable& sigma);
 #endif
 
 int main(int argc, char *argv[]) {
 	/* basic input validity checking */
-	if (argc != 7) {
-		printf("usage: ./hcrminer <minsup> <minconf> <inputfile> <outputfile> <hfrange> <maxleafsize>\n");
+	if (argc < 7) {
+		printf("usage: ./hcrminer <minsup> <minconf> <inputfile> <outputfile> <hfrange> <maxleafsize> [--threads N] [--engine apriori|eclat|fpgrowth] [--top K [--min-length L]] [--sample FRACTION] [--partitions P] [--itemsets all|closed|maximal] [--cross-check] [--binary-output] [--stream] [--stats FILE] [--save-index FILE] [--update FILE] [--serve SOCKET|-] [--sweep]\n");
 		exit(1);
 	}
 
@@ -31,26 +50,64 @@ int main(int argc, char *argv[]) {
 #ifdef _DEBUG
 	params.print();
 #endif
+	if (params.sweep)
+		return sweep(params);
+	if (is_itemset_index(params.inputfile))
+		return query_index(params);
 
-	/* get the transactions */
+	/* get the transactions, unless the partition workers read them */
 	DB T;
-	int max_item = read_db(params.inputfile, T);
+	int max_item = params.partitions? 0: read_db(params.inputfile, T, params.threads);
 	int how_many = (int) T.size();
 
+	/* the miners may prune T, so keep the transactions for the second miner */
+	DB T_check;
+	if (params.cross_check)
+		T_check = T;
+
 	/* start the clock */
 	t1 = high_resolution_clock::now();
 
 	/* get the frequent itemsets along with their support values */
 	std::vector<Itemsets> F;
 	SupportCountTable sigma;
-	apriori(sigma, F, T, params, max_item);
+	MiningStats stats;
+	if (!params.update_file.empty())
+		update(sigma, F, T, params, max_item);
+	else if (params.top_k) {
+		/* from here on the minsup is the one the top itemsets reach */
+		params.minsup = apriori_top(sigma, F, T, params, max_item);
+		std::cout << "top-k minsup: " << params.minsup << std::endl;
+	}
+	else if (params.sample)
+		sample(sigma, F, T, params, max_item);
+	else if (params.partitions) {
+		PartitionStats st = partition(sigma, F, params);
+		how_many = (int) st.transactions;
+		std::cout << "# of partitions: " << st.partitions << std::endl;
+		std::cout << "# of itemsets frequent within their partition: " << st.local_itemsets << std::endl;
+		std::cout << "# of candidates counted over all transactions: " << st.candidates << std::endl;
+	}
+	else
+		mine(params.engine, sigma, F, T, params, max_item, &stats);
 
 	t2 = high_resolution_clock::now();
 
-	/* get the rules */
+	/* get the rules, when streaming they are written as they are generated */
 	Rules rules;
-	if (params.minsup > 20)
-			get_rules(rules, sigma, F, params.minconf);
+	std::unique_ptr<RuleWriter> writer;
+	bool gen_rules = (params.minsup > 20 || !params.serve.empty()) && params.itemsets != "maximal" && !params.top_k;
+	if (gen_rules) {
+		RuleSink sink;
+		if (params.stream) {
+			writer.reset( new RuleWriter(params.outputfile, how_many, params.binary_output) );
+			sink = [&writer](const Rules &block) { writer->write(block); };
+		}
+		if (params.itemsets == "closed")
+			get_closed_rules(rules, sigma, F, params.minconf, params.threads, sink);
+		else
+			get_rules(rules, sigma, F, params.minconf, params.threads, sink);
+	}
 
 	t3 = high_resolution_clock::now();
 	
@@ -60,13 +117,35 @@ int main(int argc, char *argv[]) {
 	m_freq = duration_cast<milliseconds>(t2-t1).count();
 	m_rules = duration_cast<milliseconds>(t3-t2).count(); 
 
+	/* answer queries on the rules instead of writing them, reporting on stderr since stdout may carry the answers */
+	if (!params.serve.empty()) {
+		size_t size = 0;
+		for (const Itemsets &Fk : F)
+			size += Fk.size();
+		std::cerr << "# of rules: " << rules.size() << std::endl;
+		std::cerr << "# of frequent itemsets: " << size << std::endl;
+		std::cerr << "time-frequent: " << (float) m_freq / 1000.0 << std::endl;
+		std::cerr << "time-rules: " << (float) m_rules / 1000.0 << std::endl;
+		if (!params.index_file.empty())
+			write_itemset_index(params.index_file, F, sigma, params.minsup, how_many);
+		serve_rules(rules, how_many, params.serve);
+		return 0;
+	}
+
 	/* save the rules to output file */
-	if (params.minsup > 20) {
-		write_rules(params.outputfile, rules, how_many);
-		std::cout << "# of rules: " << rules.size() << std::endl;
+	size_t num_streamed = 0;
+	if (gen_rules) {
+		size_t num_rules = rules.size();
+		if (writer) {
+			num_rules = num_streamed = writer->size();
+			writer.reset();
+		}
+		else
+			write_rules(params.outputfile, rules, how_many, params.binary_output);
+		std::cout << "# of rules: " << num_rules << std::endl;
 	}
 	else {
-		write_frequent_itemsets(params.outputfile, F, sigma, how_many);
+		write_frequent_itemsets(params.outputfile, F, sigma, how_many, params.binary_output);
 		std::cout << "# of rules: " << -1 << std::endl;
 	}
 	
@@ -79,6 +158,27 @@ int main(int argc, char *argv[]) {
 	std::cout << "time-rules: " << (float) m_rules / 1000.0 << std::endl;
 	std::cout << "time-total: " << (float) m_total / 1000.0 << std::endl;
 
+	/* persist the frequent itemsets for later runs */
+	if (!params.index_file.empty())
+		write_itemset_index(params.index_file, F, sigma, params.minsup, how_many);
+
+	/* write the per level statistics */
+	if (!params.stats_file.empty()) {
+		stats.engine = params.engine;
+		stats.minsup = params.minsup;
+		stats.minconf = params.minconf;
+		stats.transactions = how_many;
+		stats.frequent_itemsets = size;
+		stats.rules = gen_rules? (int64_t) (rules.size()+num_streamed): -1;
+		stats.time_frequent = duration<double>(t2-t1).count();
+		stats.time_rules = duration<double>(t3-t2).count();
+		stats.time_total = duration<double>(t3-t1).count();
+		stats.write_json(params.stats_file);
+	}
+
+	if (params.cross_check && !cross_check(params, sigma, F, T_check, max_item))
+		return 1;
+
 #ifdef _DEBUG
 	debug_write_frequent_itemsets(params.inputfile+"_frequent", F, sigma);
 #endif
@@ -86,6 +186,338 @@ int main(int argc, char *argv[]) {
 	return 0;
 }
 
+/**
+ * Finds the frequent itemsets along with their support values with the given engine
+ * @param engine 	 the name of the miner, see Params
+ * @param sigma  	 [out_parameter] the support counts for all itemsets
+ * @param F      	 [out_parameter] the frequent itemsets where F[k] is the vector of all frequent k-itemsets
+ * @param T      	 all transactions
+ * @param params 	 the parameters used
+ * @param max_item the largest item found in all transactions
+ * @param stats    [out_parameter] if given, receives the per level statistics. Only apriori records more than
+ *                 the number of frequent itemsets of every level.
+ */
+void mine(const std::string &engine, SupportCountTable &sigma, std::vector<Itemsets> &F, DB &T, const Params &params, const int max_item, MiningStats *stats) {
+	if (params.itemsets != "all")
+		eclat_condensed(sigma, F, T, params, max_item, params.itemsets == "maximal");
+	else if (engine == "eclat")
+		eclat(sigma, F, T, params, max_item);
+	else if (engine == "fpgrowth")
+		fpgrowth(sigma, F, T, params, max_item);
+	else {
+		apriori(sigma, F, T, params, max_item, stats);
+		return;
+	}
+	if (stats) {
+		stats->levels.clear();
+		for (size_t k=1; k<=F.size(); k++)
+			stats->level((int) k).frequent = F[k-1].size();
+	}
+}
+
+/**
+ * Updates the frequent itemsets saved in the itemset index params.update_file to all transactions with fup,
+ * instead of mining them from scratch. The index must have been saved for the transactions T starts with,
+ * at a minsup not above params.minsup.
+ * @param sigma  	 [out_parameter] the support counts for all itemsets
+ * @param F      	 [out_parameter] the frequent itemsets where F[k] is the vector of all frequent k-itemsets
+ * @param T      	 all transactions, the old ones followed by the appended ones
+ * @param params 	 the parameters used
+ * @param max_item the largest item found in all transactions
+ */
+void update(SupportCountTable &sigma, std::vector<Itemsets> &F, DB &T, const Params &params, const int max_item) {
+	std::vector<Itemsets> old_F;
+	std::vector< std::vector<int> > old_S;
+	int old_minsup;
+	uint64_t history = read_itemset_index(params.update_file, 0, old_F, old_S, &old_minsup);
+	if (params.minsup < old_minsup) {
+		printf("the itemset index was mined with minsup %i, it can't be updated to minsup %i\n", old_minsup, params.minsup);
+		exit(1);
+	}
+	if (history > T.size()) {
+		printf("the itemset index was mined from %llu transactions, but \'%s\' has only %zu\n", (unsigned long long) history, params.inputfile.c_str(), T.size());
+		exit(1);
+	}
+
+	FupStats st = fup(sigma, F, T, (size_t) history, old_F, old_S, old_minsup, params, max_item);
+	std::cout << "# of appended transactions: " << st.delta << std::endl;
+	std::cout << "# of scans of the old transactions: " << st.history_scans << std::endl;
+	std::cout << "# of candidates counted over the old transactions: " << st.history_candidates << std::endl;
+}
+
+/**
+ * Finds the frequent itemsets of T from those of a random sample of params.sample of its transactions, mined with
+ * params.engine at a lowered minsup, with toivonen. Reports whether the negative border of the sample's itemsets
+ * showed a possible miss, which took more passes over T. A sample too small for the lowered minsup, see min_sample,
+ * is refused.
+ * @param sigma  	 [out_parameter] the support counts for all itemsets
+ * @param F      	 [out_parameter] the frequent itemsets where F[k] is the vector of all frequent k-itemsets
+ * @param T      	 all transactions
+ * @param params 	 the parameters used
+ * @param max_item the largest item found in all transactions
+ */
+void sample(SupportCountTable &sigma, std::vector<Itemsets> &F, const DB &T, const Params &params, const int max_item) {
+	size_t needed = min_sample(params.minsup, T.size());
+	if ((size_t) std::ceil(params.sample*T.size()) < needed) {
+		if (needed >= T.size())
+			printf("no sample of the %zu transactions is large enough for minsup %i, mine them without --sample\n", T.size(), params.minsup);
+		else
+			printf("a sample of %g of the transactions is too small for minsup %i, use --sample %g or more\n", params.sample,
+				params.minsup, std::ceil(1000.0*needed/T.size())/1000);
+		exit(1);
+	}
+	DB S = draw_sample(T, params.sample);
+	size_t sampled = S.size(); // the miners may prune S
+	Params lowered(params);
+	lowered.minsup = sample_minsup(params.minsup, T.size(), sampled);
+	std::vector<Itemsets> sample_F;
+	SupportCountTable sample_sigma;
+	mine(params.engine, sample_sigma, sample_F, S, lowered, max_item);
+
+	SampleStats st = toivonen(sigma, F, T, sample_F, params, max_item);
+	std::cout << "# of sampled transactions: " << sampled << " at minsup " << lowered.minsup << std::endl;
+	std::cout << "# of itemsets frequent in the sample: " << st.candidates << std::endl;
+	std::cout << "# of negative border itemsets: " << st.border << std::endl;
+	std::cout << "# of frequent negative border itemsets: " << st.border_frequent << std::endl;
+	if (st.border_frequent)
+		std::cout << "the negative border shows a possible miss, the missed candidates were counted in more passes" << std::endl;
+	std::cout << "# of passes over all transactions: " << st.passes << std::endl;
+}
+
+/**
+ * Mines T again with a second engine and compares its frequent itemsets and support counts with the given ones.
+ * The second engine is apriori, or fpgrowth if apriori was used. Empty trailing levels of F are ignored.
+ * If only the closed or maximal itemsets were mined, they are compared with those kept from all frequent itemsets,
+ * and the top itemsets with the frequent itemsets of at least min_length items at the minsup they reach.
+ * @param params 	 the parameters used
+ * @param sigma  	 the support counts found by params.engine
+ * @param F      	 the frequent itemsets found by params.engine
+ * @param T      	 all transactions
+ * @param max_item the largest item found in all transactions
+ * @return 				 True if both engines agree. False otherwise.
+ */
+bool cross_check(const Params &params, const SupportCountTable &sigma, const std::vector<Itemsets> &F, DB &T, const int max_item) {
+	std::string engine = params.engine == "apriori"? "fpgrowth": "apriori";
+	std::string miner = params.itemsets == "all"? params.engine: params.itemsets;
+	std::vector<Itemsets> F_check;
+	SupportCountTable sigma_check;
+	Params all(params);
+	all.itemsets = "all";
+	all.top_k = 0;
+	mine(engine, sigma_check, F_check, T, all, max_item);
+	if (params.top_k)
+		for (size_t k=0; k+1<(size_t) params.min_length && k<F_check.size(); k++)
+			F_check[k].clear();
+	if (params.itemsets != "all") {
+		std::vector<Itemsets> F_all;
+		F_all.swap(F_check);
+		filter_condensed(F_check, F_all, sigma_check, params.itemsets == "maximal");
+	}
+
+	size_t levels = F.size(), levels_check = F_check.size();
+	while (levels > 1 && F[levels-1].empty())
+		levels--;
+	while (levels_check > 1 && F_check[levels_check-1].empty())
+		levels_check--;
+
+	bool same = levels == levels_check;
+	for (size_t k=0; same && k<levels; k++)
+		same = F[k] == F_check[k];
+	for (auto it=F.begin(); same && it!=F.end(); it++)
+		for (const Itemset &s : *it)
+			if (sigma.at(s) != sigma_check.at(s)) {
+				same = false;
+				break;
+			}
+
+	if (same)
+		std::cout << "cross-check: " << miner << " and " << engine << " agree" << std::endl;
+	else
+		std::cout << "cross-check: " << miner << " and " << engine << " DIFFER" << std::endl;
+	return same;
+}
+
+/**
+ * Generates the rules of F and writes them, streaming them while they are generated if params.stream is set.
+ * @param fn       the output file
+ * @param F        the frequent itemsets
+ * @param sigma    the support counts of the frequent itemsets
+ * @param minconf  the minimum confidence
+ * @param how_many the number of transactions
+ * @param params   the parameters used
+ * @param t_rules  [out_parameter] the seconds spent generating, including writing when streaming
+ * @param t_write  [out_parameter] the seconds spent writing after generating
+ * @return         the number of rules
+ */
+static size_t rules_to_file(const std::string &fn, const std::vector<Itemsets> &F, const SupportCountTable &sigma, const float minconf, const int how_many, const Params &params, double &t_rules, double &t_write) {
+	high_resolution_clock::time_point a = high_resolution_clock::now();
+	Rules rules;
+	size_t num_rules = 0;
+	if (params.stream) {
+		RuleWriter writer(fn, how_many, params.binary_output);
+		get_rules(rules, sigma, F, minconf, params.threads, [&writer](const Rules &block) { writer.write(block); });
+		num_rules = writer.size();
+	}
+	else
+		get_rules(rules, sigma, F, minconf, params.threads);
+	high_resolution_clock::time_point b = high_resolution_clock::now();
+	if (!params.stream) {
+		write_rules(fn, rules, how_many, params.binary_output);
+		num_rules = rules.size();
+	}
+	t_rules = duration<double>(b-a).count();
+	t_write = duration<double>(high_resolution_clock::now()-b).count();
+	return num_rules;
+}
+
+/**
+ * Runs every combination of params.minsups, params.minconfs and params.inputfiles, reading and mining every input once.
+ * Every input is mined at the lowest minsup and the frequent itemsets of the higher minsups are filtered from those,
+ * and the rules of every minconf are generated from the same frequent itemsets.
+ * As in a single run, a configuration with minsup > 20 writes its rules to <outputfile>-<input>-<minsup>-<minconf>
+ * and otherwise its frequent itemsets to <outputfile>-<input>-<minsup>, where <input> is the input's file name.
+ * The timings of all configurations are printed and written to <outputfile>-timing.tsv.
+ * @param params the parameters used
+ * @return       the exit code
+ */
+int sweep(const Params &params) {
+	std::vector<int> minsups = params.minsups;
+	std::sort(minsups.begin(), minsups.end());
+	minsups.erase( std::unique(minsups.begin(), minsups.end()), minsups.end() );
+
+	std::string table = "input\tminsup\tminconf\ttime-read\ttime-frequent\ttime-rules\ttime-write\titemsets\trules\toutput\n";
+	char row[1024];
+	for (const std::string &fn : params.inputfiles) {
+		high_resolution_clock::time_point a = high_resolution_clock::now();
+		DB T;
+		int max_item = read_db(fn, T, params.threads);
+		int how_many = (int) T.size();
+		high_resolution_clock::time_point b = high_resolution_clock::now();
+		double t_read = duration<double>(b-a).count();
+
+		/* mine once at the lowest minsup */
+		Params run = params;
+		run.inputfile = fn;
+		run.minsup = minsups[0];
+		std::vector<Itemsets> all_F;
+		SupportCountTable sigma;
+		mine(params.engine, sigma, all_F, T, run, max_item);
+		double t_mine = duration<double>(high_resolution_clock::now()-b).count();
+
+		std::string name = params.outputfile + "-" + fn.substr(fn.find_last_of('/')+1);
+		std::vector<Itemsets> last_F;
+		const std::vector<Itemsets> *F = &all_F;
+		for (int minsup : minsups) {
+			/* the frequent itemsets of a higher minsup are a subset of those of the previous minsup */
+			a = high_resolution_clock::now();
+			if (minsup != minsups[0]) {
+				std::vector<Itemsets> filtered;
+				filter_frequent(filtered, *F, sigma, minsup);
+				last_F.swap(filtered);
+				F = &last_F;
+			}
+			double t_freq = minsup == minsups[0]? t_mine: duration<double>(high_resolution_clock::now()-a).count();
+			size_t itemsets = 0;
+			for (const Itemsets &Fk : *F)
+				itemsets += Fk.size();
+
+			if (minsup <= 20) {
+				std::string out = name + "-" + std::to_string(minsup);
+				a = high_resolution_clock::now();
+				write_frequent_itemsets(out, *F, sigma, how_many, params.binary_output);
+				double t_write = duration<double>(high_resolution_clock::now()-a).count();
+				snprintf(row, sizeof(row), "%s\t%i\t-\t%.3f\t%.3f\t%.3f\t%.3f\t%zu\t-1\t%s\n", fn.c_str(), minsup, t_read, t_freq, 0.0, t_write, itemsets, out.c_str());
+				table += row;
+				continue;
+			}
+			for (float minconf : params.minconfs) {
+				char conf[32];
+				snprintf(conf, sizeof(conf), "%g", minconf);
+				std::string out = name + "-" + std::to_string(minsup) + "-" + conf;
+				double t_rules, t_write;
+				size_t num_rules = rules_to_file(out, *F, sigma, minconf, how_many, params, t_rules, t_write);
+				snprintf(row, sizeof(row), "%s\t%i\t%s\t%.3f\t%.3f\t%.3f\t%.3f\t%zu\t%zu\t%s\n", fn.c_str(), minsup, conf, t_read, t_freq, t_rules, t_write, itemsets, num_rules, out.c_str());
+				table += row;
+			}
+		}
+	}
+
+	std::cout << table;
+	std::string timing = params.outputfile + "-timing.tsv";
+	FILE *out = fopen(timing.c_str(), "w");
+	if (!out) {
+		printf("incorrent output filename \'%s\'\n", timing.c_str());
+		exit(1);
+	}
+	fputs(table.c_str(), out);
+	fclose(out);
+	return 0;
+}
+
+/**
+ * Gets the rules or frequent itemsets from an itemset index saved with --save-index instead of mining.
+ * The transactions are never read. As in a normal run, rules are generated if minsup > 20 and the frequent
+ * itemsets are written otherwise, or the rules are served with --serve.
+ * minsup must be at least the minsup the index was saved with.
+ * @param params the parameters used, with the itemset index as the inputfile
+ * @return       the exit code
+ */
+int query_index(const Params &params) {
+	if (params.cross_check || params.sweep || !params.stats_file.empty() || !params.index_file.empty() || params.itemsets != "all") {
+		printf("an itemset index input can't be combined with --cross-check, --sweep, --stats, --save-index or --itemsets\n");
+		exit(1);
+	}
+
+	high_resolution_clock::time_point a = high_resolution_clock::now();
+	std::vector<Itemsets> F;
+	std::vector< std::vector<int> > S;
+	int how_many = (int) read_itemset_index(params.inputfile, params.minsup, F, S);
+	high_resolution_clock::time_point b = high_resolution_clock::now();
+
+	size_t num_rules = 0;
+	if (!params.serve.empty()) {
+		Rules rules;
+		get_rules(rules, SupportIndex(F, S), F, params.minconf, params.threads);
+		std::cerr << "# of rules: " << rules.size() << std::endl;
+		std::cerr << "time-load: " << duration<double>(b-a).count() << std::endl;
+		serve_rules(rules, how_many, params.serve);
+		return 0;
+	}
+	if (params.minsup > 20) {
+		Rules rules;
+		SupportIndex support(F, S);
+		if (params.stream) {
+			RuleWriter writer(params.outputfile, how_many, params.binary_output);
+			get_rules(rules, support, F, params.minconf, params.threads, [&writer](const Rules &block) { writer.write(block); });
+			num_rules = writer.size();
+		}
+		else {
+			get_rules(rules, support, F, params.minconf, params.threads);
+			write_rules(params.outputfile, rules, how_many, params.binary_output);
+			num_rules = rules.size();
+		}
+		std::cout << "# of rules: " << num_rules << std::endl;
+	}
+	else {
+		SupportCountTable sigma;
+		for (size_t k=0; k<F.size(); k++)
+			for (size_t x=0; x<F[k].size(); x++)
+				sigma[ F[k][x] ] = S[k][x];
+		write_frequent_itemsets(params.outputfile, F, sigma, how_many, params.binary_output);
+		std::cout << "# of rules: " << -1 << std::endl;
+	}
+	high_resolution_clock::time_point c = high_resolution_clock::now();
+
+	size_t size = 0;
+	for (const Itemsets &Fk : F)
+		size += Fk.size();
+	std::cout << "# of frequent itemsets: " << size << std::endl;
+	std::cout << "time-load: " << duration<double>(b-a).count() << std::endl;
+	std::cout << "time-rules: " << duration<double>(c-b).count() << std::endl;
+	std::cout << "time-total: " << duration<double>(c-a).count() << std::endl;
+	return 0;
+}
+
 #ifdef _DEBUG
 /**
  * Write the frequent itemsets in to the output file.
@@ -113,4 +545,4 @@ void debug_write_frequent_itemsets(const std::string& fn, const std::vector<Item
 	out << ss.rdbuf();
 	out.close();
 }
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,125 @@
+#include "itemset_index.hpp"
+#include "utils.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Checks whether the file starts with the itemset index magic
+ */
+bool is_itemset_index(const std::string& fn) {
+	char magic[8] = {0};
+	FILE *in = fopen(fn.c_str(), "rb");
+	if (!in)
+		return false;
+	size_t n = fread(magic, 1, sizeof(magic), in);
+	fclose(in);
+	return n == sizeof(magic) && !std::memcmp(magic, ITEMSET_INDEX_MAGIC, sizeof(magic));
+}
+
+/**
+ * Writes the frequent itemsets and their support counts to an itemset index
+ * @param fn               The output file
+ * @param F                The frequent itemsets, F[k] holding the (k+1)-itemsets in lexicographical order
+ * @param sigma            The support counts of the frequent itemsets
+ * @param minsup           The minsup F was mined with
+ * @param num_transactions The number of transactions F was mined from
+ */
+void write_itemset_index(const std::string& fn, const std::vector<Itemsets>& F, const SupportCountTable& sigma, const int minsup, const uint64_t num_transactions) {
+	OutputBuffer out(fn);
+	ItemsetIndexHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, ITEMSET_INDEX_MAGIC, sizeof(header.magic));
+	header.minsup = minsup;
+	header.num_levels = (uint32_t) F.size();
+	header.num_transactions = num_transactions;
+	out.put_raw(header);
+
+	for (const Itemsets &Fk : F) {
+		uint64_t count = Fk.size();
+		out.put_raw(count);
+	}
+	for (const Itemsets &Fk : F)
+		for (const Itemset &s : Fk)
+			out.put((const char*) s.data(), s.size()*sizeof(Item));
+	for (const Itemsets &Fk : F)
+		for (const Itemset &s : Fk) {
+			int32_t sup = sigma.at(s);
+			out.put_raw(sup);
+		}
+}
+
+/**
+ * Loads the frequent itemsets of an itemset index which reach minsup through a read-only memory mapping.
+ * Only the kept itemsets are copied out, so loading at a higher minsup than the index was mined with is a filter.
+ * @param fn           The itemset index
+ * @param minsup       The minimum support count. Must not be lower than the index's, or 0 to load every itemset.
+ * @param F            [out_param] the frequent itemsets, without empty trailing levels
+ * @param S            [out_param] S[k][x] is the support count of F[k][x]
+ * @param index_minsup [out_param] if given, the minsup the index was mined with
+ * @return             The number of transactions the index was mined from
+ */
+uint64_t read_itemset_index(const std::string& fn, const int minsup, std::vector<Itemsets>& F, std::vector< std::vector<int> >& S, int *index_minsup) {
+	int fd = open(fn.c_str(), O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(ItemsetIndexHeader)) {
+		printf("corrupt itemset index \'%s\'\n", fn.c_str());
+		exit(1);
+	}
+	size_t length = (size_t) st.st_size;
+	void *data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		printf("corrupt itemset index \'%s\'\n", fn.c_str());
+		exit(1);
+	}
+
+	/* check that the sections fit the file */
+	const ItemsetIndexHeader *header = (const ItemsetIndexHeader*) data;
+	const uint64_t *counts = (const uint64_t*) (header+1);
+	size_t expected = sizeof(ItemsetIndexHeader) + header->num_levels*sizeof(uint64_t);
+	if (std::memcmp(header->magic, ITEMSET_INDEX_MAGIC, sizeof(header->magic)) || expected > length) {
+		printf("corrupt itemset index \'%s\'\n", fn.c_str());
+		exit(1);
+	}
+	for (uint32_t k=0; k<header->num_levels; k++)
+		expected += counts[k]*(k+2)*sizeof(int32_t);
+	if (expected != length) {
+		printf("corrupt itemset index \'%s\'\n", fn.c_str());
+		exit(1);
+	}
+	if (minsup > 0 && minsup < header->minsup) {
+		printf("the itemset index was mined with minsup %i, it can't answer minsup %i\n", header->minsup, minsup);
+		exit(1);
+	}
+
+	const int32_t *items = (const int32_t*) (counts+header->num_levels), *sup = items;
+	for (uint32_t k=0; k<header->num_levels; k++)
+		sup += counts[k]*(k+1);
+
+	F.assign(header->num_levels, Itemsets());
+	S.assign(header->num_levels, std::vector<int>());
+	for (uint32_t k=0; k<header->num_levels; k++) {
+		for (uint64_t x=0; x<counts[k]; x++, items+=k+1, sup++)
+			if (*sup >= minsup) {
+				F[k].push_back( Itemset(items, items+k+1) );
+				S[k].push_back(*sup);
+			}
+	}
+	while (!F.empty() && F.back().empty()) {
+		F.pop_back();
+		S.pop_back();
+	}
+
+	if (index_minsup)
+		*index_minsup = header->minsup;
+	uint64_t num_transactions = header->num_transactions;
+	munmap(data, length);
+	return num_transactions;
+}
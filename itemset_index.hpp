@@ -0,0 +1,29 @@
+#ifndef _ITEMSET_INDEX_HPP
+#define _ITEMSET_INDEX_HPP
+
+#include "types.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define ITEMSET_INDEX_MAGIC "HCRIDX1"
+
+/**
+ * Header of the itemset index, the persisted result of a mining run. It is followed by
+ *   uint64_t counts[num_levels]             the number of frequent (k+1)-itemsets of every level k
+ *   int32_t  items[sum of counts[k]*(k+1)]  the items of every itemset, level by level, in lexicographical order
+ *   int32_t  sup[sum of counts[k]]          the support count of every itemset, in the same order
+ */
+struct ItemsetIndexHeader {
+	char magic[8];
+	int32_t minsup;
+	uint32_t num_levels;
+	uint64_t num_transactions;
+};
+
+bool is_itemset_index(const std::string& fn);
+void write_itemset_index(const std::string& fn, const std::vector<Itemsets>& F, const SupportCountTable& sigma, const int minsup, const uint64_t num_transactions);
+uint64_t read_itemset_index(const std::string& fn, const int minsup, std::vector<Itemsets>& F, std::vector< std::vector<int> >& S, int *index_minsup = NULL);
+
+#endif
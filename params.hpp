@@ -2,6 +2,10 @@
 #define _PARAMS_HPP
 
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
 
 #include "types.hpp"
 
@@ -10,18 +14,197 @@ struct Params {
 	float minconf;
 	std::string inputfile, outputfile;
 	int hfrange, maxleafsize;
+	int threads;
+	int top_k, min_length;
+	double sample;
+	int partitions;
+	std::string engine, itemsets;
+	bool cross_check;
+	bool binary_output, stream;
+	std::string stats_file, index_file, serve, update_file;
+	bool sweep;
+	std::vector<int> minsups;
+	std::vector<float> minconfs;
+	std::vector<std::string> inputfiles;
 	
+	/**
+	 * The defaults used when hcrminer is not run from the command line, e.g., by hcrbench
+	 */
+	Params() : minsup(1), minconf(0), hfrange(10), maxleafsize(50), threads(1), top_k(0), min_length(1), sample(0), partitions(0), engine("apriori"), itemsets("all"), cross_check(false),
+		binary_output(false), stream(false), sweep(false) {}
+
+	/**
+	 * Reads the six positional parameters followed by any optional flags.
+	 * hfrange and maxleafsize may be given as auto, stored as 0, to let every level's hash tree choose its own.
+	 * The flags are:
+	 *   --threads N      number of worker threads used for support counting (default 1)
+	 *   --engine NAME    the miner used to find the frequent itemsets, apriori (default), eclat or fpgrowth
+	 *   --top K          find the K most frequent itemsets instead of those reaching minsup, which becomes the lowest
+	 *                    support considered. The itemsets are written and no rules are generated.
+	 *   --min-length L   with --top, only count the itemsets of at least L items (default 1)
+	 *   --sample FRACTION mine a random sample of FRACTION of the transactions at a lowered minsup and count the itemsets
+	 *                    frequent in it and their negative border in one pass over all transactions, with more passes
+	 *                    only if the border shows that a frequent itemset may have been missed
+	 *   --partitions P   split inputfile into P partitions which are read and mined with apriori at a share of minsup
+	 *                    by worker processes, --threads at a time, and count the union of their frequent itemsets
+	 *                    in a second read, so only a partition has to fit in memory
+	 *   --itemsets WHICH all (default) frequent itemsets, or only the closed or the maximal ones, which are found by a
+	 *                    search over eclat's tid-lists that skips the other ones. Rules are generated between closed
+	 *                    itemsets with closed and not at all with maximal.
+	 *   --cross-check    also mine with a second engine and exit with an error if the frequent itemsets differ
+	 *   --binary-output  write the rules or frequent itemsets in the compact binary format instead of text
+	 *   --stream         write the rules while they are being generated instead of once all are found
+	 *   --stats FILE     write the per level statistics of the run as JSON to FILE
+	 *   --save-index FILE  save the frequent itemsets and their support counts to the itemset index FILE, which can be
+	 *                    given as inputfile to get rules or frequent itemsets at the same or a higher minsup without mining
+	 *   --update FILE    instead of mining all of inputfile, update the frequent itemsets of the itemset index FILE, which
+	 *                    was saved for the transactions inputfile starts with, to the transactions appended since
+	 *   --serve WHERE    instead of writing outputfile, keep the rules in memory and answer queries for the rules whose LHS
+	 *                    is a subset of a basket on the Unix domain socket WHERE, or on stdin if WHERE is -
+	 *   --sweep          treat minsup, minconf and inputfile as comma separated lists and run every combination,
+	 *                    loading every input once. outputfile is then the prefix of all output files.
+	 */
+	/**
+	 * Parses hfrange or maxleafsize, which is either a positive integer or auto, stored as 0.
+	 */
+	static int tree_param(const char *name, const char *arg) {
+		if (!std::strcmp(arg, "auto"))
+			return 0;
+		char *end;
+		long v = std::strtol(arg, &end, 10);
+		if (end == arg || *end || v < 1 || v > 1<<30) {
+			printf("<%s> must be a positive integer or auto, not \'%s\'\n", name, arg);
+			exit(1);
+		}
+		return (int) v;
+	}
+
 	Params(int argc, char *argv[]) {
 		minsup = std::atoi(argv[1]);
 		minconf = std::atof(argv[2]);
 		inputfile = argv[3];
 		outputfile = argv[4];
-		hfrange = std::atoi(argv[5]);
-		maxleafsize = std::atoi(argv[6]);
+		hfrange = tree_param("hfrange", argv[5]);
+		maxleafsize = tree_param("maxleafsize", argv[6]);
+		threads = 1;
+		top_k = 0;
+		min_length = 1;
+		sample = 0;
+		partitions = 0;
+		engine = "apriori";
+		itemsets = "all";
+		cross_check = false;
+		binary_output = false;
+		stream = false;
+		sweep = false;
+
+		for (int i=7; i<argc; i++) {
+			if (!std::strcmp(argv[i], "--threads") && i+1<argc)
+				threads = std::atoi(argv[++i]);
+			else if (!std::strcmp(argv[i], "--engine") && i+1<argc)
+				engine = argv[++i];
+			else if (!std::strcmp(argv[i], "--top") && i+1<argc)
+				top_k = std::max(0, std::atoi(argv[++i]));
+			else if (!std::strcmp(argv[i], "--min-length") && i+1<argc)
+				min_length = std::max(1, std::atoi(argv[++i]));
+			else if (!std::strcmp(argv[i], "--sample") && i+1<argc)
+				sample = std::atof(argv[++i]);
+			else if (!std::strcmp(argv[i], "--partitions") && i+1<argc)
+				partitions = std::max(1, std::atoi(argv[++i]));
+			else if (!std::strcmp(argv[i], "--itemsets") && i+1<argc)
+				itemsets = argv[++i];
+			else if (!std::strcmp(argv[i], "--cross-check"))
+				cross_check = true;
+			else if (!std::strcmp(argv[i], "--binary-output"))
+				binary_output = true;
+			else if (!std::strcmp(argv[i], "--stream"))
+				stream = true;
+			else if (!std::strcmp(argv[i], "--stats") && i+1<argc)
+				stats_file = argv[++i];
+			else if (!std::strcmp(argv[i], "--save-index") && i+1<argc)
+				index_file = argv[++i];
+			else if (!std::strcmp(argv[i], "--update") && i+1<argc)
+				update_file = argv[++i];
+			else if (!std::strcmp(argv[i], "--serve") && i+1<argc)
+				serve = argv[++i];
+			else if (!std::strcmp(argv[i], "--sweep"))
+				sweep = true;
+			else {
+				printf("unknown option \'%s\'\n", argv[i]);
+				exit(1);
+			}
+		}
+		if (threads < 1)
+			threads = 1;
+		for (const std::string &v : split(argv[1]))
+			minsups.push_back( std::atoi(v.c_str()) );
+		for (const std::string &v : split(argv[2]))
+			minconfs.push_back( std::atof(v.c_str()) );
+		inputfiles = split(argv[3]);
+		if (!sweep && (minsups.size() > 1 || minconfs.size() > 1 || inputfiles.size() > 1)) {
+			printf("lists of minsup, minconf or inputfile need --sweep\n");
+			exit(1);
+		}
+		if (sweep && (cross_check || !stats_file.empty() || !serve.empty() || !update_file.empty())) {
+			printf("--sweep can't be combined with --cross-check, --stats, --serve or --update\n");
+			exit(1);
+		}
+		if (!update_file.empty() && !stats_file.empty()) {
+			printf("--update can't be combined with --stats\n");
+			exit(1);
+		}
+		if (!serve.empty() && stream) {
+			printf("--serve can't be combined with --stream\n");
+			exit(1);
+		}
+		if (itemsets != "all" && itemsets != "closed" && itemsets != "maximal") {
+			printf("unknown itemsets \'%s\'\n", itemsets.c_str());
+			exit(1);
+		}
+		if (itemsets != "all" && (sweep || !update_file.empty() || !index_file.empty())) {
+			printf("--itemsets %s can't be combined with --sweep, --update or --save-index\n", itemsets.c_str());
+			exit(1);
+		}
+		if (top_k && (sweep || !update_file.empty() || !index_file.empty() || !serve.empty() || itemsets != "all")) {
+			printf("--top can't be combined with --sweep, --update, --save-index, --serve or --itemsets\n");
+			exit(1);
+		}
+		if (sample && !(sample > 0 && sample < 1)) {
+			printf("the sample fraction must be between 0 and 1\n");
+			exit(1);
+		}
+		if (sample && (sweep || !update_file.empty() || top_k || itemsets != "all" || !stats_file.empty())) {
+			printf("--sample can't be combined with --sweep, --update, --top, --itemsets or --stats\n");
+			exit(1);
+		}
+		if (partitions && (sweep || !update_file.empty() || top_k || sample || itemsets != "all" || !stats_file.empty() || cross_check || engine != "apriori")) {
+			printf("--partitions can't be combined with --sweep, --update, --top, --sample, --itemsets, --stats, --cross-check or --engine\n");
+			exit(1);
+		}
+		if (itemsets == "maximal" && !serve.empty()) {
+			printf("--serve needs rules, which aren't generated from maximal itemsets\n");
+			exit(1);
+		}
+		if (engine != "apriori" && engine != "eclat" && engine != "fpgrowth") {
+			printf("unknown engine \'%s\'\n", engine.c_str());
+			exit(1);
+		}
+	}
+
+	/**
+	 * Splits a comma separated list
+	 */
+	static std::vector<std::string> split(const std::string &list) {
+		std::vector<std::string> out;
+		size_t start = 0;
+		for (size_t comma; (comma = list.find(',', start)) != std::string::npos; start = comma+1)
+			out.push_back( list.substr(start, comma-start) );
+		out.push_back( list.substr(start) );
+		return out;
 	}
 
 	void print() {
-		printf("minsup: %i minconf: %.3f inputfile: %s outputfile: %s hfrange: %i maxleafsize: %i\n", minsup, minconf, inputfile.c_str(), outputfile.c_str(), hfrange, maxleafsize);
+		printf("minsup: %i minconf: %.3f inputfile: %s outputfile: %s hfrange: %i maxleafsize: %i threads: %i top: %i min-length: %i sample: %.3f partitions: %i engine: %s itemsets: %s binary-output: %i stream: %i stats: %s save-index: %s serve: %s update: %s\n", minsup, minconf, inputfile.c_str(), outputfile.c_str(), hfrange, maxleafsize, threads, top_k, min_length, sample, partitions, engine.c_str(), itemsets.c_str(), binary_output, stream, stats_file.c_str(), index_file.c_str(), serve.c_str(), update_file.c_str());
 	}
 };
 
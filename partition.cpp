@@ -0,0 +1,197 @@
+#include "partition.hpp"
+#include "apriori.hpp"
+#include "itemset_index.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * Runs work(p) for every partition p in a forked worker process, at most workers at a time.
+ * A worker's exit status is the return value of work.
+ * @param parts   the number of partitions
+ * @param workers the number of worker processes running at once
+ * @param work    the work of a worker, which only returns results through files
+ * @return        the number of workers which failed
+ */
+static int run_workers(const int parts, const int workers, const std::function<int(int)> &work) {
+	int running = 0, failed = 0, status;
+	for (int p=0; p<parts || running; ) {
+		if (p < parts && running < workers) {
+			std::cout.flush(); // or the child would write the buffered output again
+			fflush(stdout);
+			pid_t pid = fork();
+			if (pid < 0) {
+				printf("can't fork a partition worker\n");
+				exit(1);
+			}
+			if (pid == 0)
+				_exit(work(p));
+			running++;
+			p++;
+		}
+		else if (wait(&status) > 0) {
+			failed += !WIFEXITED(status) || WEXITSTATUS(status);
+			running--;
+		}
+	}
+	return failed;
+}
+
+/**
+ * Finds the frequent itemsets of the input file with the Partition algorithm of Savasere et al., "An Efficient
+ * Algorithm for Mining Association Rules in Large Databases", reading the input twice and never all of it at once.
+ * The input is split into params.partitions partitions on transaction boundaries, see split_db. In the first phase
+ * every partition is read and mined with apriori by a worker process at its share of minsup. The shares add up
+ * to less than minsup plus the number of partitions, so an itemset which is below its share in every partition is
+ * below minsup, i.e., every frequent itemset is frequent in some partition. In the second phase the union of the
+ * local itemsets is counted exactly by a worker process per partition, and the counts are added up. The workers
+ * hand their results back through files next to params.outputfile, named after the process, and at most params.threads of them run at once.
+ * @param sigma  [out_param] the support counts of the frequent itemsets
+ * @param F      [out_param] the frequent itemsets where F[k] is the vector of all frequent (k+1)-itemsets
+ * @param params the parameters used, i.e., minsup, inputfile, outputfile, hfrange, maxleafsize, partitions, threads
+ * @return       the number of transactions and how many itemsets were counted
+ */
+PartitionStats partition(SupportCountTable &sigma, std::vector<Itemsets> &F, const Params &params) {
+	PartitionStats st;
+	st.transactions = st.local_itemsets = st.candidates = 0;
+
+	/* the non-empty partitions, each with its share of minsup by size */
+	std::vector<uint64_t> bound = split_db(params.inputfile, params.partitions), lo, hi;
+	std::vector<int> share;
+	for (int p=0; p<params.partitions; p++)
+		if (bound[p+1] > bound[p]) {
+			lo.push_back(bound[p]);
+			hi.push_back(bound[p+1]);
+			share.push_back( std::max(1, (int) std::ceil( (double) params.minsup*(bound[p+1]-bound[p])/bound.back() )) );
+		}
+	st.partitions = (int) lo.size();
+	std::string prefix = params.outputfile + ".part" + std::to_string(getpid()) + "-"; // runs may share the outputfile
+	auto part_file = [&prefix](const int p) { return prefix + std::to_string(p); };
+	auto remove_files = [&]() {
+		for (int p=0; p<st.partitions; p++)
+			std::remove(part_file(p).c_str());
+	};
+	auto check = [&](const int failed) {
+		if (!failed)
+			return;
+		remove_files();
+		printf("%i partition workers failed\n", failed);
+		exit(1);
+	};
+
+	/* phase 1: the itemsets frequent within every partition */
+	check( run_workers(st.partitions, params.threads, [&](int p) {
+		DB T;
+		int max_item = read_db_part(params.inputfile, T, lo[p], hi[p]);
+		uint64_t how_many = T.size();
+		Params local(params);
+		local.minsup = share[p];
+		local.threads = 1;
+		std::vector<Itemsets> F_local;
+		SupportCountTable sigma_local;
+		if (!T.empty())
+			apriori(sigma_local, F_local, T, local, max_item);
+		write_itemset_index(part_file(p), F_local, sigma_local, local.minsup, how_many);
+		return 0;
+	}) );
+
+	/* their union, in lexicographical order, makes the candidates */
+	std::vector< std::unordered_set<Itemset, ItemsetHash> > in_union;
+	for (int p=0; p<st.partitions; p++) {
+		std::vector<Itemsets> F_local;
+		std::vector< std::vector<int> > S_local;
+		st.transactions += read_itemset_index(part_file(p), 0, F_local, S_local, NULL);
+		if (in_union.size() < F_local.size())
+			in_union.resize(F_local.size());
+		for (size_t k=0; k<F_local.size(); k++) {
+			st.local_itemsets += F_local[k].size();
+			in_union[k].insert(F_local[k].begin(), F_local[k].end());
+		}
+	}
+	std::vector<Itemsets> C(in_union.size());
+	for (size_t k=0; k<C.size(); k++) {
+		C[k].assign(in_union[k].begin(), in_union[k].end());
+		std::sort(C[k].begin(), C[k].end());
+		st.candidates += C[k].size();
+	}
+	in_union.clear();
+	Item top = C.empty() || C[0].empty()? -1: C[0].back()[0];
+
+	/* phase 2: every worker counts the candidates over its partition in one pass */
+	check( run_workers(st.partitions, params.threads, [&](int p) {
+		DB T;
+		int max_item = read_db_part(params.inputfile, T, lo[p], hi[p]);
+		Params local(params);
+		local.threads = 1;
+		/* the items in no candidate are dropped first, as apriori drops the infrequent ones */
+		int items = std::max(max_item, top)+1; // a text partition only knows its own items
+		std::vector<int> code(items, -1);
+		for (size_t id=0; !C.empty() && id<C[0].size(); id++)
+			code[ C[0][id][0] ] = C[0][id][0];
+		T.recode(code, 1, false);
+		std::vector<int> item_counts(items, 0);
+		std::vector< std::vector<int> > counts;
+		count_levels(item_counts, counts, T, C, local);
+		if (!C.empty()) {
+			counts[0].clear();
+			for (const Itemset &c : C[0])
+				counts[0].push_back(item_counts[ c[0] ]);
+		}
+		FILE *out = fopen(part_file(p).c_str(), "wb");
+		if (!out)
+			return 1;
+		for (const std::vector<int> &Ck_counts : counts)
+			if (fwrite(Ck_counts.data(), sizeof(int), Ck_counts.size(), out) != Ck_counts.size())
+				return 1;
+		return fclose(out)? 1: 0;
+	}) );
+
+	/* add up the counts, keeping the itemsets which reach minsup */
+	std::vector< std::vector<int> > total(C.size());
+	for (size_t k=0; k<C.size(); k++)
+		total[k].assign(C[k].size(), 0);
+	std::vector<int> counts;
+	for (int p=0; p<st.partitions; p++) {
+		FILE *in = fopen(part_file(p).c_str(), "rb");
+		for (size_t k=0; in && k<C.size(); k++) {
+			counts.resize(C[k].size());
+			if (fread(counts.data(), sizeof(int), counts.size(), in) != counts.size()) {
+				fclose(in);
+				in = NULL;
+				break;
+			}
+			for (size_t id=0; id<counts.size(); id++)
+				total[k][id] += counts[id];
+		}
+		if (!in) {
+			printf("can't read the counts of partition %i from \'%s\'\n", p, part_file(p).c_str());
+			remove_files();
+			exit(1);
+		}
+		fclose(in);
+	}
+	remove_files();
+
+	F.assign(1, Itemsets());
+	for (size_t k=0; k<C.size(); k++) {
+		if (k >= F.size())
+			F.push_back(Itemsets());
+		for (size_t id=0; id<C[k].size(); id++)
+			if (total[k][id] >= params.minsup) {
+				sigma[ C[k][id] ] = total[k][id];
+				F[k].push_back( std::move(C[k][id]) );
+			}
+	}
+	while (F.size() > 1 && F.back().empty())
+		F.pop_back();
+	return st;
+}
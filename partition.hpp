@@ -0,0 +1,22 @@
+#ifndef _PARTITION_HPP
+#define _PARTITION_HPP
+
+#include "params.hpp"
+#include "types.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * What the two phases of a partitioned run did
+ */
+struct PartitionStats {
+	uint64_t transactions;   // transactions over all partitions
+	int partitions;          // non-empty partitions, each mined by its own worker process
+	uint64_t local_itemsets; // itemsets frequent within their partition, summed over the partitions
+	uint64_t candidates;     // distinct ones among them, counted over all transactions
+};
+
+PartitionStats partition(SupportCountTable &sigma, std::vector<Itemsets> &F, const Params &params);
+
+#endif
@@ -0,0 +1,224 @@
+#include "rule_server.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* how long to wait before accepting again when the process is out of descriptors or buffers */
+#define ACCEPT_BACKOFF_MS 100
+/* the maximum number of connections answered at once */
+#define MAX_CLIENTS 256
+
+/**
+ * Files every rule under the item of its LHS with the fewest rules
+ * @param rules The rules, which must outlive the index
+ */
+RuleIndex::RuleIndex(const Rules &rules) : rules(&rules) {
+	Item max_item = -1;
+	for (const Rule &r : rules)
+		max_item = std::max(max_item, r.LHS[r.LHS.size()-1]);
+	std::vector<uint64_t> in_lhs(max_item+1, 0);
+	for (const Rule &r : rules)
+		for (Item i : r.LHS)
+			in_lhs[i]++;
+
+	/* file every rule under its rarest LHS item */
+	std::vector<Item> key(rules.size());
+	bucket_off.assign(max_item+2, 0);
+	for (size_t x=0; x<rules.size(); x++) {
+		Rule r = rules[x];
+		Item best = r.LHS[0];
+		for (Item i : r.LHS)
+			if (in_lhs[i] < in_lhs[best])
+				best = i;
+		key[x] = best;
+		bucket_off[best+1]++;
+	}
+	for (size_t i=1; i<bucket_off.size(); i++)
+		bucket_off[i] += bucket_off[i-1];
+	ids.resize(rules.size());
+	std::vector<uint64_t> fill(bucket_off.begin(), bucket_off.end()-1);
+	for (size_t x=0; x<rules.size(); x++)
+		ids[ fill[ key[x] ]++ ] = (uint32_t) x;
+
+	/* order every bucket by decreasing confidence, then decreasing support, then rule order */
+	auto before = [&rules](uint32_t a, uint32_t b) {
+		Rule ra = rules[a], rb = rules[b];
+		if (ra.conf != rb.conf)
+			return ra.conf > rb.conf;
+		if (ra.sup != rb.sup)
+			return ra.sup > rb.sup;
+		return a < b;
+	};
+	for (size_t i=0; i+1<bucket_off.size(); i++)
+		std::sort(ids.begin()+bucket_off[i], ids.begin()+bucket_off[i+1], before);
+}
+
+/**
+ * Finds the rules whose LHS is a subset of the basket, in decreasing order of confidence
+ * @param basket The items of the basket, sorted increasingly without duplicates
+ * @param n      The maximum number of rules to find
+ * @param out    [out_param] The indices of the found rules in the indexed Rules
+ */
+void RuleIndex::query(const std::vector<Item> &basket, const size_t n, std::vector<uint32_t> &out) const {
+	out.clear();
+	const Rules &R = *rules;
+	auto before = [&R](uint32_t a, uint32_t b) {
+		Rule ra = R[a], rb = R[b];
+		if (ra.conf != rb.conf)
+			return ra.conf > rb.conf;
+		if (ra.sup != rb.sup)
+			return ra.sup > rb.sup;
+		return a < b;
+	};
+
+	/* merge the buckets of the basket's items, each head being the next best rule of its bucket */
+	typedef std::pair<uint64_t, uint64_t> Cursor; // the position in ids and the end of its bucket
+	auto worse = [&](const Cursor &a, const Cursor &b) { return before(ids[b.first], ids[a.first]); };
+	std::priority_queue<Cursor, std::vector<Cursor>, decltype(worse)> heads(worse);
+	Item max_item = (Item) bucket_off.size()-2;
+	for (Item i : basket)
+		if (i >= 0 && i <= max_item && bucket_off[i] < bucket_off[i+1])
+			heads.push( Cursor(bucket_off[i], bucket_off[i+1]) );
+
+	while (out.size() < n && !heads.empty()) {
+		Cursor c = heads.top();
+		heads.pop();
+		Rule r = R[ ids[c.first] ];
+		if (std::includes(basket.begin(), basket.end(), r.LHS.begin(), r.LHS.end()))
+			out.push_back(ids[c.first]);
+		if (++c.first < c.second)
+			heads.push(c);
+	}
+}
+
+/**
+ * Answers the queries read from in until it ends or sends quit. Every query is a line
+ *   top <N> <item> <item> ...
+ * which is answered with the at most N rules whose LHS is a subset of the items, by decreasing confidence,
+ * in the rule output format, followed by an empty line. Malformed lines are answered with an error line
+ * followed by an empty line.
+ */
+static void answer(const RuleIndex &index, const Rules &rules, const int how_many, FILE *in, FILE *out) {
+	RuleWriter writer(out, how_many);
+	std::vector<Item> basket;
+	std::vector<uint32_t> found;
+	char *line = NULL;
+	size_t cap = 0;
+	while (getline(&line, &cap, in) > 0) {
+		char *p = line, *end;
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (!std::strncmp(p, "quit", 4) && std::strspn(p+4, " \t\r\n") == std::strlen(p+4)) // the whole token
+			break;
+		if (std::strncmp(p, "top ", 4)) {
+			fputs("error: expected \'top <N> <item> ...\' or \'quit\'\n\n", out);
+			fflush(out);
+			continue;
+		}
+		long n = std::strtol(p+4, &end, 10);
+		basket.clear();
+		for (p = end; ; p = end) {
+			long item = std::strtol(p, &end, 10);
+			if (end == p)
+				break;
+			basket.push_back((Item) item);
+		}
+		std::sort(basket.begin(), basket.end());
+		basket.erase( std::unique(basket.begin(), basket.end()), basket.end() );
+
+		index.query(basket, n > 0? (size_t) n: 0, found);
+		for (uint32_t id : found)
+			writer.write(rules[id]);
+		writer.flush();
+		fputs("\n", out);
+		fflush(out);
+	}
+	free(line);
+}
+
+/**
+ * Indexes the rules by antecedent and answers queries on them until stopped, see answer. Running out of descriptors
+ * only pauses accepting connections, any other failure to accept one is reported and ends the process.
+ * @param rules    The rules to serve
+ * @param how_many The number of transactions the rules were mined from
+ * @param where    "-" to answer the queries on stdin, otherwise the path of the Unix domain socket to listen on.
+ *                 Every connection is answered on its own thread, up to MAX_CLIENTS at once.
+ */
+void serve_rules(const Rules &rules, const int how_many, const std::string &where) {
+	RuleIndex index(rules);
+	if (where == "-") {
+		answer(index, rules, how_many, stdin, stdout);
+		return;
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	struct sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (fd < 0 || where.size() >= sizeof(addr.sun_path)) {
+		printf("can't listen on \'%s\'\n", where.c_str());
+		exit(1);
+	}
+	std::strcpy(addr.sun_path, where.c_str());
+	unlink(where.c_str());
+	if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+		printf("can't listen on \'%s\'\n", where.c_str());
+		exit(1);
+	}
+	printf("serving %zu rules on %s\n", rules.size(), where.c_str());
+	fflush(stdout);
+
+	/* a client that hangs up mid-answer must not take the server down */
+	signal(SIGPIPE, SIG_IGN);
+	std::atomic<int> clients(0);
+	for (;;) {
+		int conn = accept(fd, NULL, NULL);
+		if (conn < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			/* out of descriptors or buffers until some client hangs up */
+			if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+				std::this_thread::sleep_for( std::chrono::milliseconds(ACCEPT_BACKOFF_MS) );
+				continue;
+			}
+			perror("can't accept a connection");
+			exit(1);
+		}
+		if (clients >= MAX_CLIENTS) {
+			const char busy[] = "error: too many clients\n\n";
+			ssize_t w = write(conn, busy, sizeof(busy)-1);
+			(void) w;
+			close(conn);
+			continue;
+		}
+		clients++;
+		std::thread([&index, &rules, how_many, conn, &clients]() {
+			FILE *in = fdopen(conn, "r"), *out = NULL;
+			int conn_out = in? dup(conn): -1;
+			if (conn_out >= 0 && !(out = fdopen(conn_out, "w")))
+				close(conn_out);
+			if (in && out)
+				answer(index, rules, how_many, in, out);
+			if (in)
+				fclose(in);
+			else
+				close(conn);
+			if (out)
+				fclose(out);
+			clients--;
+		}).detach();
+	}
+}
@@ -0,0 +1,28 @@
+#ifndef _RULE_SERVER_HPP
+#define _RULE_SERVER_HPP
+
+#include "types.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * The rules indexed by antecedent, for finding the rules whose LHS is a subset of a basket.
+ * Every rule is filed under one item of its LHS, the one filed under the fewest rules, and every item's bucket is
+ * ordered by decreasing confidence. A query merges the buckets of the basket's items in that order and checks the
+ * rest of every LHS against the basket, so it stops as soon as it has found the top N.
+ * The index is never modified after construction, so any number of threads can query it at once.
+ */
+class RuleIndex {
+	const Rules *rules;
+	std::vector<uint64_t> bucket_off; // the bucket of item i is ids[bucket_off[i], bucket_off[i+1])
+	std::vector<uint32_t> ids;
+public:
+	RuleIndex(const Rules &rules);
+	void query(const std::vector<Item> &basket, const size_t n, std::vector<uint32_t> &out) const;
+};
+
+void serve_rules(const Rules &rules, const int how_many, const std::string &where);
+
+#endif
@@ -0,0 +1,174 @@
+#include "sample.hpp"
+#include "apriori.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <unordered_set>
+
+/* the seed of the sample, so runs can be repeated */
+#define SAMPLE_SEED 1
+/* how many standard deviations minsup is lowered by in the sample, about a 0.001 chance per itemset to miss it */
+#define SAMPLE_Z 3.09
+/* the most minsup may be lowered by, as a fraction of the scaled minsup. A sample which needs more is too small
+ * for the bound to mean anything, its itemsets would mostly be noise and far more than those of all transactions */
+#define SAMPLE_MAX_LOWER 0.5
+
+/**
+ * Draws about fraction of the transactions uniformly at random, keeping their order, with selection sampling.
+ * @param T        all transactions
+ * @param fraction the fraction of the transactions to draw, in (0, 1)
+ * @return         the sampled transactions, owned
+ */
+DB draw_sample(const DB &T, const double fraction) {
+	std::mt19937_64 rng(SAMPLE_SEED);
+	size_t N = T.size(), n = std::min(N, (size_t) std::ceil(fraction*N));
+	DB sample;
+	sample.reserve( (size_t) (fraction*T.num_occurrences()) );
+	for (size_t x=0, left=n; x<N && left; x++)
+		if ((rng() >> 11) * (1.0/9007199254740992.0) * (N-x) < left) { // the next transaction is drawn with probability left/(N-x)
+			for (Item i : T[x])
+				sample.add_item(i);
+			sample.end_transaction();
+			left--;
+		}
+	return sample;
+}
+
+/**
+ * The smallest sample for which sample_minsup lowers the scaled minsup by at most SAMPLE_MAX_LOWER of it.
+ * With p the relative minsup, SAMPLE_Z*sqrt(n*p*(1-p)) <= SAMPLE_MAX_LOWER*n*p holds from n = (SAMPLE_Z/SAMPLE_MAX_LOWER)^2*(1-p)/p on.
+ * @param minsup       the minsup over all transactions
+ * @param transactions the number of transactions
+ * @return             the number of transactions the sample needs
+ */
+size_t min_sample(const int minsup, const size_t transactions) {
+	double p = std::min(1.0, (double) minsup/std::max((size_t) 1, transactions)), z = SAMPLE_Z/SAMPLE_MAX_LOWER;
+	return (size_t) std::ceil(z*z*(1-p)/p);
+}
+
+/**
+ * The minsup to mine a sample with, so that an itemset reaching minsup in all transactions is unlikely to miss it
+ * in the sample. The count of such an itemset in the sample is about binomial, so minsup is scaled to the sample
+ * and lowered by SAMPLE_Z standard deviations. Assumes a sample of at least min_sample transactions, so that is
+ * at most SAMPLE_MAX_LOWER of the scaled minsup. The misses the bound allows are caught by the negative border.
+ * @param minsup       the minsup over all transactions
+ * @param transactions the number of transactions
+ * @param sampled      the number of sampled transactions
+ * @return             the lowered minsup, at least 1
+ */
+int sample_minsup(const int minsup, const size_t transactions, const size_t sampled) {
+	double p = std::min(1.0, (double) minsup/std::max((size_t) 1, transactions)), mean = p*sampled;
+	return std::max(1, (int) std::floor(mean - SAMPLE_Z*std::sqrt(mean*(1-p))));
+}
+
+/**
+ * Finds the frequent itemsets of all transactions from those of a sample, as in Toivonen's "Sampling Large
+ * Databases for Association Rules". The itemsets frequent in the sample and their negative border, i.e., the
+ * itemsets which aren't but whose subsets all are, are counted over all transactions in a single pass. Every
+ * candidate apriori_gen generates from a level of the sample's itemsets is one or the other, and every item is
+ * counted. If no border itemset is frequent, the frequent itemsets among the counted ones are all of them.
+ * Otherwise a frequent itemset may have been missed, and the candidates apriori_gen generates from the frequent
+ * itemsets found so far which weren't counted yet are counted in further passes, until there are none.
+ * @param sigma    [out_param] the support counts of the frequent itemsets
+ * @param F        [out_param] the frequent itemsets where F[k] is the vector of all frequent (k+1)-itemsets
+ * @param T        all transactions
+ * @param sample_F the itemsets frequent in a sample of T at a lowered minsup
+ * @param params   the parameters used, i.e., minsup, hfrange, maxleafsize and threads
+ * @param maxitem  the largest item found in all transactions
+ * @return         how good the sample was and how many passes were needed
+ */
+SampleStats toivonen(SupportCountTable &sigma, std::vector<Itemsets> &F, const DB &T, const std::vector<Itemsets> &sample_F,
+	const Params &params, const Item maxitem) {
+	int minsup = params.minsup;
+	SampleStats st;
+	st.candidates = st.border = st.border_frequent = 0;
+
+	/* the sample's itemsets in lexicographical order, which apriori_gen needs */
+	std::vector<Itemsets> S(sample_F);
+	std::unordered_set<Itemset, ItemsetHash> in_sample;
+	for (Itemsets &Sk : S) {
+		for (Itemset &s : Sk)
+			std::sort(s.begin(), s.end());
+		std::sort(Sk.begin(), Sk.end());
+		in_sample.insert(Sk.begin(), Sk.end());
+		st.candidates += Sk.size();
+	}
+
+	/* C[k] are the candidate (k+1)-itemsets, the sample's and their negative border */
+	std::vector<Itemsets> C(1);
+	for (size_t k=0; k<S.size() && !S[k].empty(); k++) {
+		C.push_back(Itemsets());
+		apriori_gen(C.back(), S[k], params.threads);
+	}
+	std::vector<int> item_counts(maxitem+1, 0);
+	std::vector< std::vector<int> > counts;
+	count_levels(item_counts, counts, T, C, params);
+	st.passes = 1;
+
+	F.assign(1, Itemsets());
+	for (Item i=0; i<=maxitem; i++) {
+		Itemset s({i});
+		bool border = !in_sample.count(s);
+		st.border += border && item_counts[i];
+		if (item_counts[i] >= minsup) {
+			st.border_frequent += border;
+			sigma[s] = item_counts[i];
+			F[0].push_back( std::move(s) );
+		}
+	}
+	for (size_t k=1; k<C.size(); k++) {
+		F.push_back(Itemsets());
+		for (size_t id=0; id<C[k].size(); id++) {
+			bool border = !in_sample.count(C[k][id]);
+			st.border += border;
+			if (counts[k][id] >= minsup) {
+				st.border_frequent += border;
+				sigma[ C[k][id] ] = counts[k][id];
+				F[k].push_back(C[k][id]);
+			}
+		}
+	}
+
+	/* a frequent border itemset may have frequent supersets which weren't counted */
+	if (st.border_frequent) {
+		std::vector< std::unordered_set<Itemset, ItemsetHash> > counted;
+		for (const Itemsets &Ck : C)
+			counted.push_back( std::unordered_set<Itemset, ItemsetHash>(Ck.begin(), Ck.end()) );
+		for (;;) {
+			std::vector<Itemsets> N(1);
+			bool any = false;
+			for (size_t k=0; k<F.size() && !F[k].empty(); k++) {
+				Itemsets gen;
+				apriori_gen(gen, F[k], params.threads);
+				N.push_back(Itemsets());
+				for (Itemset &c : gen)
+					if (k+1 >= counted.size() || !counted[k+1].count(c))
+						N.back().push_back( std::move(c) );
+				any = any || !N.back().empty();
+			}
+			if (!any)
+				break;
+
+			std::vector<int> no_items;
+			count_levels(no_items, counts, T, N, params);
+			st.passes++;
+			counted.resize( std::max(counted.size(), N.size()) );
+			F.resize( std::max(F.size(), N.size()) );
+			for (size_t k=1; k<N.size(); k++) {
+				for (size_t id=0; id<N[k].size(); id++) {
+					counted[k].insert(N[k][id]);
+					if (counts[k][id] >= minsup) {
+						sigma[ N[k][id] ] = counts[k][id];
+						F[k].push_back(N[k][id]);
+					}
+				}
+				std::sort(F[k].begin(), F[k].end());
+			}
+		}
+	}
+
+	while (F.size() > 1 && F.back().empty())
+		F.pop_back();
+	return st;
+}
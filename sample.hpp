@@ -0,0 +1,26 @@
+#ifndef _SAMPLE_HPP
+#define _SAMPLE_HPP
+
+#include "params.hpp"
+#include "types.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * How well the itemsets frequent in a sample predicted those frequent in all transactions
+ */
+struct SampleStats {
+	uint64_t candidates;      // itemsets frequent in the sample, counted over all transactions
+	uint64_t border;          // itemsets of their negative border, counted along with them
+	uint64_t border_frequent; // border itemsets frequent in all transactions, i.e., possible misses
+	int passes;               // passes over all transactions
+};
+
+DB draw_sample(const DB &T, const double fraction);
+size_t min_sample(const int minsup, const size_t transactions);
+int sample_minsup(const int minsup, const size_t transactions, const size_t sampled);
+SampleStats toivonen(SupportCountTable &sigma, std::vector<Itemsets> &F, const DB &T, const std::vector<Itemsets> &sample_F,
+	const Params &params, const Item maxitem);
+
+#endif
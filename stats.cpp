@@ -0,0 +1,51 @@
+#include "stats.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/resource.h>
+
+/**
+ * @return the stats of level k, adding the levels up to k if they don't exist yet
+ */
+LevelStats &MiningStats::level(const int k) {
+	while ((int) levels.size() < k)
+		levels.push_back( LevelStats((int) levels.size()+1) );
+	return levels[k-1];
+}
+
+/**
+ * Writes the statistics as a JSON object with one entry per level
+ * @param fn The output file
+ */
+void MiningStats::write_json(const std::string &fn) const {
+	FILE *out = fopen(fn.c_str(), "w");
+	if (!out) {
+		printf("incorrent stats filename \'%s\'\n", fn.c_str());
+		exit(1);
+	}
+	fprintf(out, "{\n  \"engine\": \"%s\",\n  \"minsup\": %i,\n  \"minconf\": %g,\n  \"transactions\": %llu,\n", engine.c_str(), minsup, minconf, (unsigned long long) transactions);
+	fprintf(out, "  \"frequent_itemsets\": %llu,\n  \"rules\": %lld,\n", (unsigned long long) frequent_itemsets, (long long) rules);
+	fprintf(out, "  \"time_frequent\": %.6f,\n  \"time_rules\": %.6f,\n  \"time_total\": %.6f,\n  \"peak_rss_kb\": %ld,\n  \"levels\": [", time_frequent, time_rules, time_total, peak_rss_kb());
+	for (size_t x=0; x<levels.size(); x++) {
+		const LevelStats &l = levels[x];
+		fprintf(out, "%s\n    {\"k\": %i, \"candidates\": %llu, \"subset_pruned\": %llu, \"frequent\": %llu, \"transactions\": %llu, ",
+			x? ",": "", l.k, (unsigned long long) l.candidates, (unsigned long long) l.subset_pruned, (unsigned long long) l.frequent, (unsigned long long) l.transactions);
+		fprintf(out, "\"trimmed\": %llu, \"pruned_db\": %llu, \"pruned_tree\": %llu, \"tree_nodes\": %i, \"tree_leaves\": %i, \"tree_depth\": %i, \"tree_branching\": %i, \"tree_leaf_size\": %i, ",
+			(unsigned long long) l.trimmed, (unsigned long long) l.pruned_db, (unsigned long long) l.pruned_tree, l.tree_nodes, l.tree_leaves, l.tree_depth,
+			l.tree_branching, l.tree_leaf_size);
+		fprintf(out, "\"prune_time\": %.6f, \"gen_time\": %.6f, \"build_time\": %.6f, \"count_time\": %.6f, \"peak_rss_kb\": %ld}",
+			l.prune_time, l.gen_time, l.build_time, l.count_time, l.peak_rss_kb);
+	}
+	fprintf(out, "\n  ]\n}\n");
+	fclose(out);
+}
+
+/**
+ * @return the peak resident set size of the process so far in KB
+ */
+long peak_rss_kb() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
@@ -0,0 +1,53 @@
+#ifndef _STATS_HPP
+#define _STATS_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * What happened while finding the frequent k-itemsets.
+ * Fields that don't apply to a level or an engine stay 0, e.g., the hash tree of the directly counted levels 1 and 2.
+ */
+struct LevelStats {
+	int k;
+	uint64_t candidates;    // candidates counted
+	uint64_t subset_pruned; // candidates dropped by apriori_gen because a (k-1)-subset is infrequent
+	uint64_t frequent;      // frequent k-itemsets found
+	uint64_t transactions;  // transactions scanned
+	uint64_t trimmed;       // transactions removed because too few of their items can still be frequent
+	uint64_t pruned_db;     // transactions removed by prune_db
+	uint64_t pruned_tree;   // transactions removed because they touched no candidate in the hash tree
+	int tree_nodes, tree_leaves, tree_depth;
+	int tree_branching, tree_leaf_size; // the hash tree parameters used, which differ per level in auto mode
+	double prune_time;      // seconds spent recoding, trimming and pruning the transactions
+	double gen_time;        // seconds spent generating the candidates
+	double build_time;      // seconds spent building the hash tree
+	double count_time;      // seconds spent counting support
+	long peak_rss_kb;       // peak resident set size once the level is done
+
+	LevelStats(const int k) : k(k), candidates(0), subset_pruned(0), frequent(0), transactions(0), trimmed(0), pruned_db(0),
+		pruned_tree(0), tree_nodes(0), tree_leaves(0), tree_depth(0), tree_branching(0), tree_leaf_size(0), prune_time(0), gen_time(0), build_time(0),
+		count_time(0), peak_rss_kb(0) {}
+};
+
+/**
+ * The statistics of a mining run. The levels are filled in by the engine, the totals by the caller.
+ */
+struct MiningStats {
+	std::vector<LevelStats> levels;
+	std::string engine;
+	int minsup;
+	float minconf;
+	uint64_t transactions, frequent_itemsets;
+	int64_t rules; // -1 if no rules were generated
+	double time_frequent, time_rules, time_total;
+
+	MiningStats() : minsup(0), minconf(0), transactions(0), frequent_itemsets(0), rules(-1), time_frequent(0), time_rules(0), time_total(0) {}
+	LevelStats &level(const int k);
+	void write_json(const std::string &fn) const;
+};
+
+long peak_rss_kb();
+
+#endif
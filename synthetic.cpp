@@ -0,0 +1,159 @@
+#include "synthetic.hpp"
+#include "binary_db.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Draws the patterns, their weights and their corruption levels
+ * @param params The generator parameters
+ */
+QuestGenerator::QuestGenerator(const QuestParams &params) : params(params), rng(params.seed), carried(-1), seen(params.num_items, 0) {
+	int n = std::max(1, params.num_patterns), N = std::max(1, params.num_items);
+	patterns.resize(n);
+	weight.resize(n);
+	corruption.resize(n);
+	double total = 0;
+	for (int p=0; p<n; p++) {
+		/* the size of a pattern is poisson distributed around avg_pattern_len, capped by the number of items */
+		int sz = std::min(N, std::max(1, poisson(params.avg_pattern_len)));
+		std::vector<Item> &pattern = patterns[p];
+
+		/* an exponentially distributed fraction of its items comes from the previous pattern, the rest is random */
+		if (p > 0) {
+			const std::vector<Item> &prev = patterns[p-1];
+			int from_prev = std::min( (int) prev.size(), (int) std::lround(sz*std::min(1.0, exponential(params.correlation))) );
+			for (int x=0; x<from_prev; x++) {
+				Item i = prev[ (size_t) (uniform()*prev.size()) ];
+				if (!seen[i]) {
+					seen[i] = 1;
+					pattern.push_back(i);
+				}
+			}
+		}
+		while ((int) pattern.size() < sz) {
+			Item i = (Item) (uniform()*N);
+			if (!seen[i]) {
+				seen[i] = 1;
+				pattern.push_back(i);
+			}
+		}
+		for (Item i : pattern)
+			seen[i] = 0;
+
+		total += weight[p] = exponential(1);
+		corruption[p] = std::min(1.0, std::max(0.0, normal(params.corruption, std::sqrt(0.1))));
+	}
+	for (int p=0; p<n; p++)
+		weight[p] = (p? weight[p-1]: 0) + weight[p]/total;
+}
+
+/**
+ * A uniform variate in [0, 1)
+ */
+double QuestGenerator::uniform() {
+	return (rng() >> 11) * (1.0/9007199254740992.0);
+}
+
+double QuestGenerator::exponential(const double mean) {
+	return -mean*std::log(1-uniform());
+}
+
+double QuestGenerator::normal(const double mean, const double stddev) {
+	double u1 = 1-uniform(), u2 = uniform();
+	return mean + stddev*std::sqrt(-2*std::log(u1))*std::cos(2*M_PI*u2);
+}
+
+/**
+ * A poisson variate, drawn by counting exponential inter-arrival times, so large means don't underflow
+ */
+int QuestGenerator::poisson(const double mean) {
+	int k = 0;
+	for (double t = exponential(1); t < mean; t += exponential(1))
+		k++;
+	return k;
+}
+
+/**
+ * Picks a pattern with probability proportional to its weight
+ */
+int QuestGenerator::pick_pattern() {
+	double u = uniform();
+	int p = (int) (std::upper_bound(weight.begin(), weight.end(), u) - weight.begin());
+	return std::min(p, (int) weight.size()-1);
+}
+
+/**
+ * Generates the next transaction. Its size is poisson distributed around avg_len and it is filled with patterns
+ * chosen by weight, each losing items while a uniform variate is below its corruption level.
+ * A pattern that doesn't fit is put in anyway half of the time and carried over to the next transaction otherwise.
+ * @param t [out_param] the items of the transaction, sorted increasingly
+ */
+void QuestGenerator::next(std::vector<Item> &t) {
+	t.clear();
+	int sz = std::max(1, poisson(params.avg_len));
+	for (int tries=0; (int) t.size() < sz && tries < 16*sz; tries++) { // bounded, in case every pattern is fully corrupted
+		int p = carried >= 0? carried: pick_pattern();
+		carried = -1;
+
+		/* corrupt the pattern by dropping items as long as a uniform variate stays below its corruption level */
+		const std::vector<Item> &pattern = patterns[p];
+		int keep = (int) pattern.size();
+		while (keep > 0 && uniform() < corruption[p])
+			keep--;
+
+		int fresh = 0;
+		for (int x=0; x<keep; x++)
+			fresh += !seen[ pattern[x] ];
+		if ((int) t.size()+fresh > sz && !t.empty() && uniform() < 0.5) {
+			carried = p;
+			break;
+		}
+		for (int x=0; x<keep; x++)
+			if (!seen[ pattern[x] ]) {
+				seen[ pattern[x] ] = 1;
+				t.push_back(pattern[x]);
+			}
+	}
+	for (Item i : t)
+		seen[i] = 0;
+	std::sort(t.begin(), t.end());
+}
+
+/**
+ * Generates the transactions given by params and writes them in the text format of <tid> <item> lines
+ * or in the binary transaction format.
+ * @param fn     The output file
+ * @param params The generator parameters
+ * @param binary Whether to write the binary transaction format
+ * @return       The number of item occurrences written
+ */
+uint64_t write_quest(const std::string &fn, const QuestParams &params, const bool binary) {
+	QuestGenerator gen(params);
+	std::vector<Item> t;
+	uint64_t occurrences = 0;
+	if (binary) {
+		BinaryDBWriter writer(fn, params.transactions);
+		for (uint64_t tid=0; tid<params.transactions; tid++) {
+			gen.next(t);
+			writer.add(t.data(), t.size());
+			occurrences += t.size();
+		}
+		writer.close(true);
+		return occurrences;
+	}
+
+	OutputBuffer out(fn);
+	for (uint64_t tid=0; tid<params.transactions; tid++) {
+		gen.next(t);
+		for (Item i : t) {
+			out.put_int((long long) tid);
+			out.put(' ');
+			out.put_int(i);
+			out.put('\n');
+		}
+		occurrences += t.size();
+	}
+	return occurrences;
+}
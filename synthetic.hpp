@@ -0,0 +1,55 @@
+#ifndef _SYNTHETIC_HPP
+#define _SYNTHETIC_HPP
+
+#include "types.hpp"
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * The parameters of the IBM Quest style generator, named as in Agrawal and Srikant's "Fast Algorithms for Mining
+ * Association Rules": |D| transactions of average size |T| over N items, built from |L| patterns of average size |I|.
+ */
+struct QuestParams {
+	uint64_t transactions;  // |D|
+	double avg_len;         // |T|
+	int num_items;          // N
+	int num_patterns;       // |L|
+	double avg_pattern_len; // |I|
+	double correlation;     // mean fraction of a pattern's items taken from the previous pattern
+	double corruption;      // mean fraction of a pattern's items dropped when it is put in a transaction
+	uint64_t seed;
+
+	QuestParams() : transactions(100000), avg_len(10), num_items(1000), num_patterns(2000), avg_pattern_len(4),
+		correlation(0.5), corruption(0.5), seed(1) {}
+};
+
+/**
+ * Generates transactions by putting weighted, corrupted patterns into them.
+ * The random variates are derived from std::mt19937_64 by hand, so a seed gives the same transactions
+ * with any compiler and standard library.
+ */
+class QuestGenerator {
+	QuestParams params;
+	std::mt19937_64 rng;
+	std::vector< std::vector<Item> > patterns;
+	std::vector<double> weight;     // the cumulative pattern weights
+	std::vector<double> corruption; // the corruption level of every pattern
+	int carried;                    // a pattern that didn't fit into the last transaction, or -1
+	std::vector<char> seen;
+
+	double uniform();
+	double exponential(const double mean);
+	double normal(const double mean, const double stddev);
+	int poisson(const double mean);
+	int pick_pattern();
+public:
+	QuestGenerator(const QuestParams &params);
+	void next(std::vector<Item> &t);
+};
+
+uint64_t write_quest(const std::string &fn, const QuestParams &params, const bool binary);
+
+#endif
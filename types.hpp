@@ -1,17 +1,240 @@
 #ifndef _TYPES_HPP
 #define _TYPES_HPP
 
-#include <list>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
 typedef int Item;
-typedef std::vector<int> Transaction;
-typedef std::list<Transaction> DB;
-typedef Transaction Itemset;
+typedef std::vector<int> Itemset;
 typedef std::vector<Itemset> Itemsets;
 
+/**
+ * A view of a sorted run of items stored elsewhere, e.g., in the DB or in the rule pool.
+ */
+struct ItemSpan {
+	const Item *first, *last;
+	ItemSpan(const Item *b, const Item *e) : first(b), last(e) {}
+	const Item *begin() const { return first; }
+	const Item *end() const { return last; }
+	size_t size() const { return (size_t) (last-first); }
+	Item operator[](const size_t i) const { return first[i]; }
+};
+
+/* a transaction is a view of its items within the DB */
+typedef ItemSpan Transaction;
+
+class MappedDB;
+
+/**
+ * All transactions, stored contiguously: transaction x holds items[offsets[x], offsets[x+1]).
+ * The arrays are either owned by the DB or point into a private memory mapping of a binary transaction file,
+ * see read_binary_db. Transactions are removed by compacting the arrays in place.
+ */
+class DB {
+	std::vector<uint64_t> own_offsets;
+	std::vector<Item> own_items;
+	std::shared_ptr<MappedDB> mapping;
+	uint64_t *offsets;
+	Item *items;
+	size_t n;
+
+	void sync() {
+		offsets = own_offsets.data();
+		items = own_items.data();
+		n = own_offsets.size()-1;
+	}
+public:
+	class const_iterator {
+		const DB *db;
+		size_t x;
+	public:
+		const_iterator(const DB *d, const size_t i) : db(d), x(i) {}
+		Transaction operator*() const { return (*db)[x]; }
+		const_iterator &operator++() { x++; return *this; }
+		bool operator!=(const const_iterator &o) const { return x != o.x; }
+	};
+
+	DB() : own_offsets(1, 0) { sync(); }
+	DB(const DB &o) : own_offsets(o.offsets, o.offsets+o.n+1), own_items(o.items, o.items+o.offsets[o.n]) { sync(); }
+	DB(DB &&o) = default;
+	DB &operator=(DB o) {
+		own_offsets.swap(o.own_offsets);
+		own_items.swap(o.own_items);
+		mapping.swap(o.mapping);
+		std::swap(offsets, o.offsets);
+		std::swap(items, o.items);
+		std::swap(n, o.n);
+		return *this;
+	}
+
+	size_t size() const { return n; }
+	bool empty() const { return n == 0; }
+	size_t num_occurrences() const { return (size_t) offsets[n]; }
+	Transaction operator[](const size_t x) const { return Transaction(items+offsets[x], items+offsets[x+1]); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, n); }
+
+	void clear() {
+		mapping.reset();
+		own_offsets.assign(1, 0);
+		own_items.clear();
+		sync();
+	}
+
+	/**
+	 * Reserves room for the given number of item occurrences. Only for owned DBs.
+	 */
+	void reserve(const size_t num_occurrences) {
+		own_items.reserve(num_occurrences);
+		sync();
+	}
+
+	/**
+	 * Appends an item to the transaction being built. Only for owned DBs.
+	 */
+	void add_item(const Item i) {
+		own_items.push_back(i);
+	}
+
+	/**
+	 * Closes the transaction being built, sorting its items. Only for owned DBs.
+	 */
+	void end_transaction() {
+		std::sort(own_items.begin()+own_offsets.back(), own_items.end());
+		own_offsets.push_back(own_items.size());
+		sync();
+	}
+
+	/**
+	 * Appends all transactions of o. Only for owned DBs.
+	 */
+	void append(const DB &o) {
+		uint64_t base = offsets[n];
+		own_items.insert(own_items.end(), o.items, o.items+o.offsets[o.n]);
+		for (size_t x=1; x<=o.n; x++)
+			own_offsets.push_back(base+o.offsets[x]);
+		sync();
+	}
+
+	/**
+	 * Moves the transactions from x on into a new owned DB, keeping the transactions before x.
+	 * Only the moved transactions are copied, also when the DB is a memory mapping.
+	 */
+	DB split_off(const size_t x) {
+		DB tail;
+		uint64_t base = offsets[x], end = offsets[n];
+		tail.own_items.assign(items+base, items+end);
+		for (size_t y=x+1; y<=n; y++)
+			tail.own_offsets.push_back(offsets[y]-base);
+		tail.sync();
+		n = x;
+		if (!mapping) {
+			own_offsets.resize(n+1);
+			own_items.resize((size_t) base);
+			sync();
+		}
+		return tail;
+	}
+
+	/**
+	 * Keeps only the transactions [lo, hi). A memory mapping is narrowed by rebasing the kept offsets in place,
+	 * which the private mapping keeps to this process, so only the kept transactions are ever touched.
+	 */
+	void keep(const size_t lo, const size_t hi) {
+		uint64_t base = offsets[lo];
+		if (mapping) {
+			offsets += lo;
+			items += base;
+			n = hi-lo;
+			for (size_t x=0; x<=n; x++)
+				offsets[x] -= base;
+			return;
+		}
+		std::vector<uint64_t> kept(own_offsets.begin()+lo, own_offsets.begin()+hi+1);
+		for (uint64_t &o : kept)
+			o -= base;
+		own_items.erase(own_items.begin()+own_offsets[hi], own_items.end());
+		own_items.erase(own_items.begin(), own_items.begin()+base);
+		own_offsets.swap(kept);
+		sync();
+	}
+
+	/**
+	 * Uses the arrays of a memory mapping instead of owned ones.
+	 */
+	void adopt(const std::shared_ptr<MappedDB> &m, uint64_t *offs, Item *its, const size_t num) {
+		clear();
+		mapping = m;
+		offsets = offs;
+		items = its;
+		n = num;
+	}
+
+	/**
+	 * Maps every item i to code[i], dropping the items with a negative code and the transactions left with
+	 * less than min_size items, with one in-place compaction pass.
+	 * @param resort Whether the codes change the order of the items, in which case every transaction is sorted again
+	 * @return The number of removed transactions
+	 */
+	size_t recode(const std::vector<int> &code, const size_t min_size, const bool resort) {
+		uint64_t w = 0, b = offsets[0];
+		size_t kept = 0, old_n = n;
+		for (size_t x=0; x<old_n; x++) {
+			uint64_t e = offsets[x+1], start = w;
+			for (uint64_t p=b; p<e; p++)
+				if (code[ items[p] ] >= 0)
+					items[w++] = code[ items[p] ];
+			if (w-start >= min_size) {
+				if (resort)
+					std::sort(items+start, items+w);
+				offsets[++kept] = w;
+			}
+			else
+				w = start;
+			b = e;
+		}
+		n = kept;
+		if (!mapping) {
+			own_offsets.resize(n+1);
+			own_items.resize((size_t) w);
+			sync();
+		}
+		return old_n-n;
+	}
+
+	/**
+	 * Removes the transactions x for which keep[x] is false with one in-place compaction pass.
+	 * @return The number of removed transactions
+	 */
+	size_t compact(const std::vector<char> &keep) {
+		uint64_t w = 0, b = offsets[0];
+		size_t kept = 0, old_n = n;
+		for (size_t x=0; x<old_n; x++) {
+			uint64_t e = offsets[x+1];
+			if (keep[x]) {
+				if (w != b)
+					std::memmove(items+w, items+b, (size_t) (e-b)*sizeof(Item));
+				w += e-b;
+				offsets[++kept] = w;
+			}
+			b = e;
+		}
+		n = kept;
+		if (!mapping) {
+			own_offsets.resize(n+1);
+			own_items.resize((size_t) w);
+			sync();
+		}
+		return old_n-n;
+	}
+};
+
 /**
  * Hash function used to store support counts for each itemset.
  * HashFunction: http://stackoverflow.com/q/4948780/4646773
@@ -29,15 +252,109 @@ public:
 typedef std::unordered_map<Itemset, int, ItemsetHash> SupportCountTable;
 
 /**
- * Rule
+ * The support counts of the frequent itemsets, found by binary search within F[k-1] instead of hashing.
+ * Lookups take a view of the itemset, so the caller needn't build an Itemset.
+ * Assumes that the itemsets of every F[k] are ordered lexicographically.
+ */
+class SupportIndex {
+	const std::vector<Itemsets> *F;
+	std::vector< std::vector<int> > sup;
+public:
+	SupportIndex(const std::vector<Itemsets> &frequent, const SupportCountTable &sigma) : F(&frequent), sup(frequent.size()) {
+		for (size_t k=0; k<frequent.size(); k++)
+			for (const Itemset &s : frequent[k])
+				sup[k].push_back(sigma.at(s));
+	}
+
+	/**
+	 * @param frequent  the frequent itemsets
+	 * @param supports supports[k][x] is the support count of frequent[k][x]
+	 */
+	SupportIndex(const std::vector<Itemsets> &frequent, const std::vector< std::vector<int> > &supports) : F(&frequent), sup(supports) {}
+
+	/**
+	 * @return The support count of the itemset [s, s+len), or -1 if it is not frequent
+	 */
+	int operator()(const Item *s, const size_t len) const {
+		if (len == 0 || len > F->size())
+			return -1;
+		const Itemsets &Fk = (*F)[len-1];
+		auto it = std::lower_bound(Fk.begin(), Fk.end(), s, [len](const Itemset &a, const Item *b) {
+			return std::lexicographical_compare(a.begin(), a.end(), b, b+len);
+		});
+		if (it == Fk.end() || !std::equal(it->begin(), it->end(), s))
+			return -1;
+		return sup[len-1][it-Fk.begin()];
+	}
+};
+
+/**
+ * Rule, i.e., views of its LHS and RHS within the rule pool of Rules
  */
 struct Rule {
-	Itemset LHS, RHS;
+	ItemSpan LHS, RHS;
 	int sup;
 	float conf;
-	Rule(Itemset a, Itemset b, int s, float c) : LHS(a), RHS(b), sup(s), conf(c) {}
+	Rule(ItemSpan a, ItemSpan b, int s, float c) : LHS(a), RHS(b), sup(s), conf(c) {}
 };
 
-typedef std::list<Rule> Rules;
+/**
+ * All rules, stored compactly. The items of every rule, LHS followed by RHS, are kept in one shared pool
+ * and each rule only records where they start.
+ */
+class Rules {
+	struct Entry {
+		uint64_t offset;
+		uint32_t lhs_sz, rhs_sz;
+		int sup;
+		float conf;
+	};
+	std::vector<Item> pool;
+	std::vector<Entry> entries;
+public:
+	class const_iterator {
+		const Rules *rules;
+		size_t x;
+	public:
+		const_iterator(const Rules *r, const size_t i) : rules(r), x(i) {}
+		Rule operator*() const { return (*rules)[x]; }
+		const_iterator &operator++() { x++; return *this; }
+		bool operator!=(const const_iterator &o) const { return x != o.x; }
+	};
+
+	size_t size() const { return entries.size(); }
+	bool empty() const { return entries.empty(); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, entries.size()); }
+
+	Rule operator[](const size_t x) const {
+		const Entry &e = entries[x];
+		const Item *lhs = pool.data()+e.offset, *rhs = lhs+e.lhs_sz;
+		return Rule(ItemSpan(lhs, rhs), ItemSpan(rhs, rhs+e.rhs_sz), e.sup, e.conf);
+	}
+
+	void clear() {
+		pool.clear();
+		entries.clear();
+	}
+
+	void add(const Item *lhs, const size_t lhs_sz, const Item *rhs, const size_t rhs_sz, const int sup, const float conf) {
+		entries.push_back( Entry{pool.size(), (uint32_t) lhs_sz, (uint32_t) rhs_sz, sup, conf} );
+		pool.insert(pool.end(), lhs, lhs+lhs_sz);
+		pool.insert(pool.end(), rhs, rhs+rhs_sz);
+	}
+
+	/**
+	 * Appends all rules of o
+	 */
+	void append(const Rules &o) {
+		uint64_t base = pool.size();
+		pool.insert(pool.end(), o.pool.begin(), o.pool.end());
+		for (Entry e : o.entries) {
+			e.offset += base;
+			entries.push_back(e);
+		}
+	}
+};
 
 #endif
\ No newline at end of file
@@ -1,81 +1,506 @@
 #include "utils.hpp"
+#include "binary_db.hpp"
 
 #include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <thread>
 #include <vector>
 
+#include <cmath>
 #include <ctime>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+
+/**
+ * Parses the next integer in [p, end), skipping any leading whitespace.
+ * @param  p   [in/out param] The position to parse from, moved past the integer
+ * @param  end The end of the buffer
+ * @param  out [out param] The integer
+ * @return     True if an integer was parsed. False otherwise.
+ */
+static inline bool parse_int(const char *&p, const char *end, int &out) {
+	while (p<end && (*p==' ' || *p=='\t' || *p=='\n' || *p=='\r' || *p=='\v' || *p=='\f'))
+		p++;
+	bool neg = p<end && *p=='-';
+	if (p<end && (*p=='-' || *p=='+'))
+		p++;
+	if (p==end || *p<'0' || *p>'9')
+		return false;
+	int v = 0;
+	for (; p<end && *p>='0' && *p<='9'; p++)
+		v = v*10 + (*p-'0');
+	out = neg? -v: v;
+	return true;
+}
+
+/**
+ * Parses the <tid> <item> pairs in [p, end) into transactions, starting a new transaction whenever the tid changes.
+ * @param  p      The start of the chunk
+ * @param  end    The end of the chunk
+ * @param  out_db [out param] The transactions of the chunk, each sorted increasingly
+ * @return        The largest item found in the chunk
+ */
+static int parse_chunk(const char *p, const char *end, DB& out_db) {
+	int old_tid=-1, max_item=-1, tid, item;
+	bool open = false;
+	out_db.reserve( std::count(p, end, '\n')+1 ); // one pair per line
+	while (parse_int(p, end, tid) && parse_int(p, end, item)) {
+		if (old_tid != tid || !open) {
+			if (open)
+				out_db.end_transaction();
+			old_tid = tid;
+			open = true;
+		}
+		if (item > max_item)
+			max_item = item;
+		out_db.add_item(item);
+	}
+	if (open)
+		out_db.end_transaction();
+	return max_item;
+}
 
 /**
  * Reads the input file given by fn.
+ * Files in the binary transaction format (see hcrconvert) are memory mapped instead of parsed.
+ * Text files are read into a single buffer which is split into one chunk per thread on transaction boundaries,
+ * and every chunk is parsed by hand on its own thread.
  * Assumes that the transaction ids are ordered increasingly in the file.
  * Assumes that each transaction in input file has a unique element. 
- * Puts all items belonging to a transaction in a vector.
+ * Puts all items belonging to a transaction contiguously in the DB.
  * It then sorts all the transactions in increasing order
  * @param  fn      The input file
- * @param  out_db [out param] The vector of sorted transactions
+ * @param  out_db [out param] The sorted transactions
+ * @param  threads The number of threads parsing the file
  * @return         The largest item found. Range is therefore [1, max_item].
  */
-int read_db(const std::string& fn, DB& out_db) {
-	/* open inputfile and read contents into string stream */
-	std::stringstream ss;
-	std::ifstream in(fn.c_str());
-	if (!in.is_open()) {
+int read_db(const std::string& fn, DB& out_db, const int threads) {
+	if (is_binary_db(fn))
+		return read_binary_db(fn, out_db);
+
+	/* open inputfile and read contents into a buffer */
+	FILE *in = fopen(fn.c_str(), "rb");
+	if (!in) {
 		printf("incorrent input filename \'%s\'\n", fn.c_str());
 		exit(1);
 	}
-	ss << in.rdbuf();
-	in.close();
+	std::vector<char> buf;
+	if (!fseek(in, 0, SEEK_END)) {
+		long sz = ftell(in);
+		buf.reserve(sz > 0? (size_t) sz: 0);
+		rewind(in);
+	}
+	char block[1<<16];
+	for (size_t n; (n = fread(block, 1, sizeof(block), in)) > 0; )
+		buf.insert(buf.end(), block, block+n);
+	fclose(in);
+	const char *begin = buf.data(), *end = begin+buf.size();
+
+	/* split the buffer at line starts where the tid changes */
+	int chunks = std::max(1, std::min(threads, (int) (buf.size()>>16) + 1));
+	std::vector<const char*> bound(1, begin);
+	for (int c=1; c<chunks; c++) {
+		const char *p = std::max(bound.back(), begin+buf.size()*c/chunks);
+		const char *prev = p;
+		while (prev>begin && prev[-1]!='\n') // start of the line containing p
+			prev--;
+		p = std::find(p, end, '\n');
+		int prev_tid, tid;
+		bool has_tid = parse_int(prev, end, prev_tid);
+		while (p!=end) {
+			const char *line = ++p;
+			if (!has_tid || !parse_int(line, end, tid) || tid!=prev_tid)
+				break;
+			p = std::find(p, end, '\n');
+		}
+		bound.push_back(p);
+	}
+	bound.push_back(end);
+
+	/* parse the chunks */
+	std::vector<DB> parts(chunks);
+	std::vector<int> max_items(chunks, -1);
+	auto work = [&](int c) {
+		max_items[c] = parse_chunk(bound[c], bound[c+1], parts[c]);
+	};
+	if (chunks == 1)
+		work(0);
+	else {
+		std::vector<std::thread> workers;
+		for (int c=0; c<chunks; c++)
+			workers.push_back( std::thread(work, c) );
+		for (std::thread &worker : workers)
+			worker.join();
+	}
 
 	/* Clean slate */
 	out_db.clear();
+	if (chunks == 1)
+		out_db = std::move(parts[0]);
+	else
+		for (DB &part : parts)
+			out_db.append(part);
 
-	/* read all transactions */
-	int old_tid=-1, max_item=-1, tid, item;
-	while (ss >> tid >> item) {
-		if (old_tid != tid) {
-			old_tid = tid;
-			out_db.push_back(Transaction());
+	/* return max item */
+	return *std::max_element(max_items.begin(), max_items.end());
+}
+
+/**
+ * Finds the first transaction boundary at or after pos in a text input file without reading the rest of it,
+ * i.e., the start of the first line after the one holding pos-1 whose tid differs from that of the line before it.
+ * @param  in   The open input file
+ * @param  pos  The byte offset to start from
+ * @param  size The size of the file
+ * @return      The byte offset of the boundary, or size if there is none
+ */
+static long tid_boundary(FILE *in, const long pos, const long size) {
+	if (pos <= 0)
+		return 0;
+	if (pos >= size)
+		return size;
+	fseek(in, pos-1, SEEK_SET);
+	for (int c; (c = fgetc(in)) != EOF && c != '\n'; );
+	char *line = NULL;
+	size_t cap = 0;
+	ssize_t len;
+	int first_tid = 0, tid;
+	bool has_tid = false;
+	long boundary = size;
+	for (long start; (start = ftell(in)) < size && (len = getline(&line, &cap, in)) > 0; ) { // whole lines, however long
+		const char *p = line;
+		if (!parse_int(p, line+len, tid))
+			continue;
+		if (has_tid && tid != first_tid) {
+			boundary = start;
+			break;
 		}
-		if (item > max_item)
-			max_item = item;
+		first_tid = tid;
+		has_tid = true;
+	}
+	free(line);
+	return boundary;
+}
+
+/**
+ * Splits the input file given by fn into parts partitions on transaction boundaries, without reading it.
+ * The bounds of a binary transaction file are transaction ids, those of a text file are byte offsets found by
+ * tid_boundary. Either way about the same amount of the input falls into every partition, some may be empty.
+ * @param  fn    The input file
+ * @param  parts The number of partitions
+ * @return       The parts+1 bounds, partition p being [bound[p], bound[p+1]), see read_db_part
+ */
+std::vector<uint64_t> split_db(const std::string& fn, const int parts) {
+	std::vector<uint64_t> bound(1, 0);
+	if (is_binary_db(fn)) {
+		MappedDB mapped;
+		if (!mapped.open(fn)) {
+			printf("corrupt binary input file \'%s\'\n", fn.c_str());
+			exit(1);
+		}
+		uint64_t n = mapped.header->num_transactions;
+		for (int p=1; p<=parts; p++)
+			bound.push_back(n*p/parts);
+		return bound;
+	}
 
-		out_db.back().push_back(item);
+	FILE *in = fopen(fn.c_str(), "rb");
+	if (!in || fseek(in, 0, SEEK_END)) {
+		printf("incorrent input filename \'%s\'\n", fn.c_str());
+		exit(1);
 	}
+	long size = ftell(in);
+	for (int p=1; p<parts; p++)
+		bound.push_back( std::max(bound.back(), (uint64_t) tid_boundary(in, (long) (size*(double) p/parts), size)) );
+	bound.push_back( (uint64_t) size );
+	fclose(in);
+	return bound;
+}
 
-	/* sort transactions in ascending order */
-	for (Transaction t : out_db)
-		std::sort(t.begin(), t.end());
+/**
+ * Reads one partition of the input file given by fn, as split by split_db, so that only it has to fit in memory.
+ * A binary transaction file is memory mapped and narrowed to the transactions [lo, hi), the bytes [lo, hi) of a
+ * text file are read and parsed.
+ * @param  fn     The input file
+ * @param  out_db [out param] The sorted transactions of the partition
+ * @param  lo     The first bound of the partition
+ * @param  hi     The bound after the partition
+ * @return        The largest item found, which for a binary file is that of all of it
+ */
+int read_db_part(const std::string& fn, DB& out_db, const uint64_t lo, const uint64_t hi) {
+	if (is_binary_db(fn)) {
+		int max_item = read_binary_db(fn, out_db);
+		out_db.keep((size_t) lo, (size_t) hi);
+		return max_item;
+	}
 
-	/* return max item */
-	return max_item;
+	FILE *in = fopen(fn.c_str(), "rb");
+	if (!in) {
+		printf("incorrent input filename \'%s\'\n", fn.c_str());
+		exit(1);
+	}
+	std::vector<char> buf((size_t) (hi-lo));
+	if (fseek(in, (long) lo, SEEK_SET) || fread(buf.data(), 1, buf.size(), in) != buf.size()) {
+		printf("can't read bytes %llu to %llu of \'%s\'\n", (unsigned long long) lo, (unsigned long long) hi, fn.c_str());
+		exit(1);
+	}
+	fclose(in);
+	out_db.clear();
+	return parse_chunk(buf.data(), buf.data()+buf.size(), out_db);
+}
+
+/* powers of ten used by OutputBuffer::put_float */
+static const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7};
+
+OutputBuffer::OutputBuffer(const std::string& fn) : owned(true), len(0) {
+	out = fopen(fn.c_str(), "wb");
+	if (!out) {
+		printf("incorrent output filename \'%s\'\n", fn.c_str());
+		exit(1);
+	}
+}
+
+/**
+ * Writes to an already open file, e.g., a socket, which is left open
+ */
+OutputBuffer::OutputBuffer(FILE *file) : out(file), owned(false), len(0) {}
+
+OutputBuffer::~OutputBuffer() {
+	flush();
+	if (owned)
+		fclose(out);
+}
+
+/**
+ * Writes the buffered bytes to the file
+ */
+void OutputBuffer::flush() {
+	if (len)
+		fwrite(buf, 1, len, out);
+	len = 0;
+	if (!owned)
+		fflush(out);
+}
+
+void OutputBuffer::put(const char *s, const size_t n) {
+	if (len+n > sizeof(buf)) {
+		flush();
+		if (n > sizeof(buf)) {
+			fwrite(s, 1, n, out);
+			return;
+		}
+	}
+	std::memcpy(buf+len, s, n);
+	len += n;
+}
+
+/**
+ * Writes the integer in decimal
+ */
+void OutputBuffer::put_int(long long v) {
+	char tmp[24], *p = tmp+sizeof(tmp);
+	unsigned long long u = v<0? 0ULL-(unsigned long long) v: (unsigned long long) v;
+	do {
+		*--p = (char) ('0' + u%10);
+		u /= 10;
+	} while (u);
+	if (v < 0)
+		*--p = '-';
+	put(p, (size_t) (tmp+sizeof(tmp)-p));
+}
+
+/**
+ * Writes the float with 3 significant digits exactly as a stream with precision 3 does, i.e., as printf's %.3g.
+ * Values in [1e-4, 1e3) that are not within rounding error of a tie are formatted by hand, the rest by snprintf.
+ */
+void OutputBuffer::put_float(const float f) {
+	double v = f;
+	if (v > 0 && v >= 1e-4 && v < 1e3) {
+		int e = (int) std::floor(std::log10(v));
+		double scaled = e<=2? v*POW10[2-e]: v/POW10[e-2];
+		if (scaled >= 1000) {
+			e++;
+			scaled /= 10;
+		}
+		else if (scaled < 100) {
+			e--;
+			scaled *= 10;
+		}
+		double low = std::floor(scaled), frac = scaled-low;
+		if (e >= -4 && e <= 2 && std::fabs(frac-0.5) > 1e-6) {
+			int r = (int) low + (frac > 0.5);
+			if (r == 1000) {
+				r = 100;
+				e++;
+			}
+			if (e <= 2) {
+				char digits[3] = {(char) ('0'+r/100), (char) ('0'+r/10%10), (char) ('0'+r%10)};
+				int nd = 3;
+				while (nd > e+1 && nd > 1 && digits[nd-1] == '0') // strip trailing zeros after the point
+					nd--;
+				char tmp[16];
+				int n = 0;
+				if (e < 0) {
+					tmp[n++] = '0';
+					tmp[n++] = '.';
+					for (int z=-1; z>e; z--)
+						tmp[n++] = '0';
+					for (int d=0; d<nd; d++)
+						tmp[n++] = digits[d];
+				}
+				else
+					for (int d=0; d<nd; d++) {
+						if (d == e+1)
+							tmp[n++] = '.';
+						tmp[n++] = digits[d];
+					}
+				put(tmp, n);
+				return;
+			}
+		}
+	}
+	char tmp[32];
+	int n = snprintf(tmp, sizeof(tmp), "%.3g", v);
+	put(tmp, (size_t) n);
+}
+
+/**
+ * Overwrites n bytes at the given position of the file, e.g., to fill in a count once it is known
+ */
+void OutputBuffer::patch(const long pos, const void *data, const size_t n) {
+	flush();
+	fseek(out, pos, SEEK_SET);
+	fwrite(data, 1, n, out);
+	fseek(out, 0, SEEK_END);
+}
+
+/**
+ * Writes the header of a binary result file. Its count is filled in by patch_binary_count.
+ */
+static void write_binary_header(OutputBuffer &out, const char *magic, const int how_many) {
+	char m[8] = {0};
+	std::memcpy(m, magic, std::min(sizeof(m), std::strlen(magic)));
+	uint64_t count = 0, transactions = (uint64_t) how_many;
+	out.put(m, sizeof(m));
+	out.put_raw(count);
+	out.put_raw(transactions);
+}
+
+static void patch_binary_count(OutputBuffer &out, const uint64_t count) {
+	out.patch(8, &count, sizeof(count));
+}
+
+/**
+ * @param fn       The output file
+ * @param how_many Number of transactions
+ * @param binary   Whether to write the binary rule format instead of text
+ */
+RuleWriter::RuleWriter(const std::string& fn, const int how_many, const bool binary) : out(fn), how_many(how_many), binary(binary), count(0) {
+	if (binary)
+		write_binary_header(out, RULES_MAGIC, how_many);
+}
+
+/**
+ * Writes text rules to an already open file, which is left open
+ * @param file     The output file
+ * @param how_many Number of transactions
+ */
+RuleWriter::RuleWriter(FILE *file, const int how_many) : out(file), how_many(how_many), binary(false), count(0) {}
+
+RuleWriter::~RuleWriter() {
+	if (binary)
+		patch_binary_count(out, count);
+}
+
+/**
+ * Writes the rules.
+ * Text format: <lhs items> | <rhs items> | <support> | <confidence>, where the support is relative to how_many.
+ * Binary format: per rule the uint32 LHS and RHS sizes, the int32 support count, the float confidence,
+ * then the int32 LHS and RHS items.
+ * @param rules The rules
+ */
+void RuleWriter::write(const Rules& rules) {
+	for (size_t x=0; x<rules.size(); x++)
+		write(rules[x]);
+}
+
+/**
+ * Writes one rule, see above
+ */
+void RuleWriter::write(const Rule& rule) {
+	count++;
+	if (binary) {
+		uint32_t lhs_sz = (uint32_t) rule.LHS.size(), rhs_sz = (uint32_t) rule.RHS.size();
+		out.put_raw(lhs_sz);
+		out.put_raw(rhs_sz);
+		out.put_raw(rule.sup);
+		out.put_raw(rule.conf);
+		out.put((const char*) rule.LHS.begin(), lhs_sz*sizeof(Item));
+		out.put((const char*) rule.RHS.begin(), rhs_sz*sizeof(Item));
+		return;
+	}
+	for (Item i : rule.LHS) {
+		out.put_int(i);
+		out.put(' ');
+	}
+	out.put("| ", 2);
+	for (Item i : rule.RHS) {
+		out.put_int(i);
+		out.put(' ');
+	}
+	out.put("| ", 2);
+	out.put_float( (float)rule.sup/(float)how_many );
+	out.put(" | ", 3);
+	out.put_float(rule.conf);
+	out.put('\n');
+}
+
+/**
+ * Writes out the buffered rules
+ */
+void RuleWriter::flush() {
+	out.flush();
 }
 
 /**
  * Write the frequent itemsets in to the output file.
- * Format of output file: { <item1> <item2> <itemN> } <length> <support-count>.
+ * Text format: <item1> <item2> <itemN> | {} | <support> | -1, where the support is relative to how_many.
+ * Binary format: per itemset the uint32 size, the int32 support count, then the int32 items.
  * Also the output file is sorted in increasing order of itemset size and lexicographically for itemsets with same size.
- * @param fn 			the name of the file
- * @param F 			the number of frequent itemsets
- * @params sigma 	the support count of each itemset
- */
-void write_frequent_itemsets(const std::string& fn, const std::vector<Itemsets>& F, const SupportCountTable& sigma, const int how_many) {
-	std::stringstream ss;
-	ss.precision(3);
-	for (const Itemsets sets : F)
-		for (const Itemset set : sets) {
+ * @param fn 			 the name of the file
+ * @param F 			 the number of frequent itemsets
+ * @params sigma 	 the support count of each itemset
+ * @param how_many Number of transactions
+ * @param binary   Whether to write the binary itemset format instead of text
+ */
+void write_frequent_itemsets(const std::string& fn, const std::vector<Itemsets>& F, const SupportCountTable& sigma, const int how_many, const bool binary) {
+	OutputBuffer out(fn);
+	uint64_t count = 0;
+	if (binary)
+		write_binary_header(out, ITEMSETS_MAGIC, how_many);
+	for (const Itemsets &sets : F)
+		for (const Itemset &set : sets) {
 			int sc = sigma.at(set);
-			for (Item i : set)
-				ss << i << " ";
-			ss << "| {} | " << (float)sc/(float)how_many << " | -1\n";
+			count++;
+			if (binary) {
+				uint32_t sz = (uint32_t) set.size();
+				out.put_raw(sz);
+				out.put_raw(sc);
+				out.put((const char*) set.data(), sz*sizeof(Item));
+				continue;
+			}
+			for (Item i : set) {
+				out.put_int(i);
+				out.put(' ');
+			}
+			out.put("| {} | ", 7);
+			out.put_float( (float)sc/(float)how_many );
+			out.put(" | -1\n", 6);
 		}
-
-	std::ofstream out(fn.c_str());
-	out << ss.rdbuf();
-	out.close();
+	if (binary)
+		patch_binary_count(out, count);
 }
 
 
@@ -104,22 +529,11 @@ Itemset set_dif(const Itemset &set1, const Itemset &set2) {
  * @param fn    		The output file
  * @param rules 		The rules
  * @param how_many	Number of transactions
+ * @param binary    Whether to write the binary rule format instead of text
  */
-void write_rules(const std::string& fn, const Rules& rules, const int how_many) {
-	std::stringstream ss;
-	ss.precision(3);
-	for (Rule rule : rules) {
-		for (Item i : rule.LHS)
-			ss << i << " ";
-		ss << "| ";
-		for (Item i : rule.RHS)
-			ss << i << " ";
-		ss << "| " << (float)rule.sup/(float)how_many << " | " << rule.conf << "\n";
-	}
-
-	std::ofstream out(fn.c_str());
-	out << ss.rdbuf();
-	out.close();
+void write_rules(const std::string& fn, const Rules& rules, const int how_many, const bool binary) {
+	RuleWriter writer(fn, how_many, binary);
+	writer.write(rules);
 }
 
 /**
@@ -3,13 +3,67 @@
 
 #include "types.hpp"
 
+#include <cstdint>
+#include <cstdio>
 #include <string>
 #include <vector>
 
-int read_db(const std::string& fn, DB& out_vec);
-void write_frequent_itemsets(const std::string& fn, const std::vector<Itemsets>& F, const SupportCountTable& sigma, const int how_many);
+/* magics of the binary result files, each followed by a uint64 record count and the uint64 number of transactions */
+#define RULES_MAGIC "HCRRUL1"
+#define ITEMSETS_MAGIC "HCRSET1"
+
+/**
+ * Writes to a file through a fixed-size buffer, with fast integer and float formatting.
+ */
+class OutputBuffer {
+	FILE *out;
+	bool owned;
+	char buf[1<<16];
+	size_t len;
+public:
+	OutputBuffer(const std::string& fn);
+	OutputBuffer(FILE *file);
+	~OutputBuffer();
+	void flush();
+	void put(const char *s, const size_t n);
+	void put(const char c) {
+		if (len == sizeof(buf))
+			flush();
+		buf[len++] = c;
+	}
+	template <typename T>
+	void put_raw(const T &v) {
+		put((const char*) &v, sizeof(v));
+	}
+	void put_int(long long v);
+	void put_float(const float f);
+	void patch(const long pos, const void *data, const size_t n);
+};
+
+/**
+ * Writes rules to a file as they are handed to it, e.g., by get_rules while it is still generating.
+ */
+class RuleWriter {
+	OutputBuffer out;
+	int how_many;
+	bool binary;
+	size_t count;
+public:
+	RuleWriter(const std::string& fn, const int how_many, const bool binary);
+	RuleWriter(FILE *file, const int how_many);
+	~RuleWriter();
+	void write(const Rules& rules);
+	void write(const Rule& rule);
+	void flush();
+	size_t size() const { return count; }
+};
+
+int read_db(const std::string& fn, DB& out_vec, const int threads = 1);
+std::vector<uint64_t> split_db(const std::string& fn, const int parts);
+int read_db_part(const std::string& fn, DB& out_db, const uint64_t lo, const uint64_t hi);
+void write_frequent_itemsets(const std::string& fn, const std::vector<Itemsets>& F, const SupportCountTable& sigma, const int how_many, const bool binary = false);
 Itemset set_dif(const Itemset &set1, const Itemset &set2);
-void write_rules(const std::string& fn, const Rules& rules, const int how_many);
+void write_rules(const std::string& fn, const Rules& rules, const int how_many, const bool binary = false);
 void print_itemset(const Itemset& set);
 
 #endif
\ No newline at end of file